@@ -0,0 +1,13 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+namespace eng {
+
+// Fixed-depth search over a fixed set of positions from a cleared state. The total node count is a
+// signature of search behaviour (deterministic with one thread); the time gives the speed.
+struct Bench {
+    static uint64_t run(int depth = 8, int threads = 1, size_t hashMB = 16); // prints the report, returns nodes
+};
+
+} // namespace eng
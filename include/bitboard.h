@@ -0,0 +1,64 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "types.h"
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+namespace eng {
+
+using Bitboard = uint64_t;
+
+constexpr Bitboard FILE_A_BB = 0x0101010101010101ULL;
+constexpr Bitboard FILE_H_BB = FILE_A_BB << 7;
+constexpr Bitboard RANK_1_BB = 0xFFULL;
+constexpr Bitboard RANK_8_BB = RANK_1_BB << 56;
+
+inline Bitboard sqBB(Square s) { return 1ULL << s; }
+inline int popcount(Bitboard b) { return __builtin_popcountll(b); }
+inline Square lsb(Bitboard b) { return __builtin_ctzll(b); }
+inline Square msb(Bitboard b) { return 63 - __builtin_clzll(b); }
+inline Square popLsb(Bitboard& b) { Square s = lsb(b); b &= b - 1; return s; }
+inline bool moreThanOne(Bitboard b) { return b & (b - 1); }
+inline Bitboard fileBB(int f) { return FILE_A_BB << f; }
+inline Bitboard rankBB(int r) { return RANK_1_BB << (8 * r); }
+
+// Slider lookup for one square: either a fancy magic multiply-shift or a BMI2 PEXT of the
+// relevant occupancy. Both index the same per-square slice, so one table layout serves both.
+struct Magic {
+    Bitboard mask{0};
+    Bitboard magic{0};
+    Bitboard* attacks{nullptr};
+    unsigned shift{0};
+
+    unsigned index(Bitboard occ) const;
+};
+
+struct Attacks {
+    static std::array<std::array<Bitboard,64>,2> pawn; // [color][sq]
+    static std::array<Bitboard,64> knight;
+    static std::array<Bitboard,64> king;
+    static std::array<std::array<Bitboard,64>,8> rays; // [dir][sq], dirs N,NE,E,SE,S,SW,W,NW
+    static std::array<std::array<Bitboard,64>,64> between; // squares strictly between two aligned squares
+    static std::array<std::array<Bitboard,64>,64> line;    // full line through two aligned squares, 0 otherwise
+
+    static std::array<Magic,64> bishopMagics;
+    static std::array<Magic,64> rookMagics;
+    static bool usePext; // chosen in init(): PEXT when compiled in and fast on this CPU
+
+    static void init();
+
+    static Bitboard bishop(Square s, Bitboard occ) { const Magic& m = bishopMagics[s]; return m.attacks[m.index(occ)]; }
+    static Bitboard rook(Square s, Bitboard occ) { const Magic& m = rookMagics[s]; return m.attacks[m.index(occ)]; }
+    static Bitboard queen(Square s, Bitboard occ) { return bishop(s, occ) | rook(s, occ); }
+};
+
+inline unsigned Magic::index(Bitboard occ) const {
+#ifdef __BMI2__
+    if(Attacks::usePext) return unsigned(_pext_u64(occ, mask));
+#endif
+    return unsigned(((occ & mask) * magic) >> shift);
+}
+
+} // namespace eng
@@ -1,74 +1,128 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <memory>
 #include <string>
-#include <vector>
 #include "types.h"
+#include "bitboard.h"
+#include "movegen.h"
+#include "zobrist.h"
 
 namespace eng {
 
 struct State {
-    std::array<char,64> board{}; // '.', 'PNBRQK'/'pnbrqk'
-    char side{'w'}; // 'w' or 'b'
+    std::array<Bitboard,12> pieces{}; // one bitboard per Piece
+    std::array<Bitboard,2> byColor{}; // occupancy per side
+    Bitboard occupied{0};
+    std::array<Piece,64> board = emptyBoard(); // mailbox for square -> piece lookups
+    Color side{WHITE};
     int castling{0}; // bit 1=K,2=Q,4=k,8=q
     int ep{-1};
     int halfmove{0};
     int fullmove{1};
-    int wk{-1};
-    int bk{-1};
+    uint64_t key{0}; // Zobrist key, updated incrementally by make/unmake
+
+    static std::array<Piece,64> emptyBoard(){ std::array<Piece,64> a; a.fill(NO_PIECE); return a; }
+};
+
+// what makeMove needs to take a move back, plus the key for repetition detection
+struct Undo {
+    uint64_t keyBefore{0};
+    Move m{};
+    Piece captured{NO_PIECE};
+    uint8_t castling{0};
+    int8_t ep{-1};
+    bool isNull{false};
+    uint16_t halfmove{0};
+    uint16_t fullmove{1};
+};
+
+// Undo stack for one line of play, allocated once and owned outside the Board (the UCI game,
+// each search thread), so that copying a Board is a flat copy of its State.
+class History {
+public:
+    static constexpr int CAPACITY = 2048; // a long game plus search depth
+
+    History() : buf(new Undo[CAPACITY]) {}
+    History(const History&) = delete;
+    History& operator=(const History&) = delete;
+
+    void push(const Undo& u){
+        // only the last 100 plies matter for repetitions, so an overlong game drops its oldest half
+        if(n == CAPACITY){ std::copy(&buf[CAPACITY/2], &buf[CAPACITY], &buf[0]); n = CAPACITY/2; }
+        buf[n++] = u;
+    }
+    Undo pop(){ return buf[--n]; }
+    const Undo& operator[](int i) const { return buf[i]; }
+    int size() const { return n; }
+    bool empty() const { return n == 0; }
+    void clear(){ n = 0; }
+
+private:
+    std::unique_ptr<Undo[]> buf;
+    int n{0};
 };
 
+// A Board is its State plus a pointer to the History its moves are recorded in. A plain copy shares
+// that history (fine for single-threaded probes that unmake what they make); fork() gives the copy
+// its own. A Board without a history can be queried and generate moves but not make them.
 class Board {
 public:
     State st{};
 
+    Board() = default;
+    explicit Board(History& h) : hist(&h) {}
+    Board fork(History& h) const; // same position recorded in h, with the plies repetition detection needs
+
     void setStartPos();
-    void setFEN(const std::string& fen);
+    // false (position unchanged, reason in err) unless each side has one king and the side to move
+    // cannot capture the other's
+    bool setFEN(const std::string& fen, std::string& err);
+    bool setFEN(const std::string& fen){ std::string err; return setFEN(fen, err); }
     std::string getFEN() const;
-    uint64_t positionKey() const; // Zobrist-like key
+    uint64_t positionKey() const { return st.key; } // Zobrist key, maintained incrementally
+    uint64_t computeKey() const;  // full recompute from scratch (setup and debug checks)
+    uint64_t keyAfter(const Move& m) const; // child key ignoring castling, en passant and promotion; for prefetching
     int repetitionCount() const;  // occurrences of current position in history
     bool isDrawBy50() const { return st.halfmove >= 100; }
 
-    static bool inBounds(Square s) { return s >= 0 && s < 64; }
-    static char colorOf(char p) { return p=='.'? 0 : (p>='A'&&p<='Z'? 'w':'b'); }
+    Piece pieceOn(Square s) const { return st.board[s]; }
+    Bitboard pieces(Color c, PieceType t) const { return st.pieces[makePiece(c, t)]; }
+    Bitboard pieces(Color c) const { return st.byColor[c]; }
+    Square kingSq(Color c) const { return lsb(st.pieces[makePiece(c, KING)]); }
 
-    bool squareAttacked(Square sq, char bySide) const;
+    Bitboard attackersTo(Square sq, Bitboard occ) const; // both colors
+    Bitboard attacksBy(Color c, Bitboard occ) const;     // every square attacked by side c
+    bool squareAttacked(Square sq, Color bySide) const;
+    bool inCheck() const { return squareAttacked(kingSq(st.side), ~st.side); }
+    bool isCapture(const Move& m) const { return m.type() == EN_PASSANT || st.board[m.to()] != NO_PIECE; } // before m is made
+    bool isTactical(const Move& m) const { return m.type() == PROMOTION || isCapture(m); }
 
-    bool makeMove(const Move& m);
+    void makeMove(const Move& m); // m must be legal (from the generators or matched against them)
     void unmakeMove();
     bool makeNullMove();
     void unmakeNullMove();
 
-    std::vector<Move> generateLegalMoves();
-    std::vector<Move> generateCaptures();
-    void computePins(char side, int pinnedDir[64]) const;
-    int see(const Move& m) const; // static exchange evaluation in centipawns
+    void generateLegalMoves(MoveList& out); // strictly legal, from checkers, pins and king-danger squares
+    void generateCaptures(MoveList& out); // captures, en passant and promotions
+    void generateQuiets(MoveList& out);   // everything generateCaptures leaves out, castling included
+    bool isLegal(const Move& m);          // validates a move from an untrusted source (hash move, killer)
+    Bitboard pinnedPieces(Color side) const;
+    bool see_ge(const Move& m, int threshold) const; // static exchange (x-rays included) gains at least threshold
 
 private:
-    struct Undo {
-        Move m;
-        char captured{'.'};
-        int castling{0};
-        int ep{-1};
-        int halfmove{0};
-        int fullmove{1};
-        int wk{-1};
-        int bk{-1};
-        char movedFrom{'.'};
-        char movedTo{'.'};
-        uint64_t keyBefore{0};
-        bool isNull{false};
-    };
-
-    std::vector<Undo> stack;
+    History* hist{nullptr};
+
+    void putPiece(Piece p, Square s){ Bitboard b = sqBB(s); st.pieces[p] |= b; st.byColor[colorOf(p)] |= b; st.occupied |= b; st.board[s] = p; st.key ^= Zobrist::piece[p][s]; }
+    void removePiece(Square s){ Piece p = st.board[s]; Bitboard b = sqBB(s); st.pieces[p] ^= b; st.byColor[colorOf(p)] ^= b; st.occupied ^= b; st.board[s] = NO_PIECE; st.key ^= Zobrist::piece[p][s]; }
+    void movePiece(Square from, Square to){ Piece p = st.board[from]; Bitboard b = sqBB(from) | sqBB(to); st.pieces[p] ^= b; st.byColor[colorOf(p)] ^= b; st.occupied ^= b; st.board[from] = NO_PIECE; st.board[to] = p; st.key ^= Zobrist::piece[p][from] ^ Zobrist::piece[p][to]; }
 
     // helpers
-    void genPawn(Square s, char p, std::vector<Move>& out) const;
-    void genSlides(Square s, char p, const int* dirs, int ndirs, std::vector<Move>& out) const;
-    void genKing(Square s, char p, std::vector<Move>& out) const;
-    void genCastles(Square ksq, char k, std::vector<Move>& out) const;
-    bool inKnightBounds(Square from, Square to) const;
-    bool slideOk(Square from, Square to, int d) const;
-    bool kingStepOk(Square from, Square to) const;
+    void generate(MoveList& out, GenType type);
+    void genPawns(MoveList& out, GenType type, Bitboard mask, Bitboard pinned, Square ksq) const;
+    void genPieces(MoveList& out, Bitboard targets, Bitboard pinned, Square ksq) const;
+    void genCastles(MoveList& out, Bitboard danger) const;
+    int popLeastValuable(Square to, Bitboard& occ, Bitboard& attackers, Color stm) const;
 };
 
 } // namespace eng
@@ -1,4 +1,7 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
 #include "board.h"
 
 namespace eng {
@@ -7,4 +10,25 @@ struct Eval {
     static int evaluate(const Board& b);
 };
 
+// Static evaluations keyed by position, shared by search threads without locks. One 64-bit word per
+// entry holds the upper key bits and the score, so a reader never sees half of another write.
+class EvalCache {
+public:
+    explicit EvalCache(size_t entries = 1 << 18) : table(entries), mask(entries - 1) {} // power of two
+
+    bool probe(uint64_t key, int& score) const{
+        uint64_t v = table[key & mask].load(std::memory_order_relaxed);
+        if((v ^ key) >> 32) return false;
+        score = int32_t(uint32_t(v));
+        return true;
+    }
+    void store(uint64_t key, int score){ table[key & mask].store((key & ~0xFFFFFFFFull) | uint32_t(score), std::memory_order_relaxed); }
+    void prefetch(uint64_t key) const{ __builtin_prefetch(&table[key & mask]); }
+    void clear(){ for(auto& e : table) e.store(0, std::memory_order_relaxed); }
+
+private:
+    std::vector<std::atomic<uint64_t>> table;
+    size_t mask;
+};
+
 } // namespace eng
@@ -1,8 +1,37 @@
 #pragma once
-#include <vector>
+#include <array>
 #include "types.h"
-#include "board.h"
 
 namespace eng {
-// move generation lives in Board methods for simplicity; this header is reserved if we split later
-}
+// move generation lives in Board methods for simplicity; this header holds the list type they fill
+
+enum GenType { GEN_CAPTURES, GEN_QUIETS, GEN_ALL };
+
+struct ScoredMove : Move {
+    int score;
+};
+
+// Fixed-capacity move list that lives on the stack; 256 exceeds the legal move count of any position.
+class MoveList {
+public:
+    static constexpr int CAPACITY = 256;
+
+    void push_back(const Move& m){ static_cast<Move&>(moves[n]) = m; moves[n].score = 0; ++n; }
+    void resize(int size){ n = size; }
+    void clear(){ n = 0; }
+    int size() const { return n; }
+    bool empty() const { return n == 0; }
+
+    ScoredMove& operator[](int i){ return moves[i]; }
+    const ScoredMove& operator[](int i) const { return moves[i]; }
+    ScoredMove* begin(){ return moves.data(); }
+    ScoredMove* end(){ return moves.data() + n; }
+    const ScoredMove* begin() const { return moves.data(); }
+    const ScoredMove* end() const { return moves.data() + n; }
+
+private:
+    std::array<ScoredMove, CAPACITY> moves; // left uninitialized; only [0, n) is ever read
+    int n{0};
+};
+
+} // namespace eng
@@ -0,0 +1,33 @@
+#pragma once
+#include <array>
+#include "board.h"
+
+namespace eng {
+
+// Staged move ordering: hash move, good captures, killers, quiets by history, bad captures.
+// Each stage scores its moves once and hands them out by selection, and quiet moves are only
+// generated once the earlier stages have failed to produce a cutoff.
+class MovePicker {
+public:
+    enum Stage { TT_MOVE, GEN_CAPTURES, GOOD_CAPTURES, KILLER1, KILLER2, GEN_QUIETS, QUIETS, BAD_CAPTURES, QS_GEN, QS_CAPTURES, DONE };
+
+    // main search: every legal move exactly once; killers/history may be null
+    MovePicker(Board& b, const Move& ttMove, const Move* killers, const std::array<int,64>* history);
+    // quiescence: captures and promotions, best MVV-LVA first
+    explicit MovePicker(Board& b);
+
+    bool next(Move& out); // false once every move has been returned
+    Stage stage() const { return stage_; } // GOOD_CAPTURES while handing out captures with see >= 0
+
+private:
+    Board& b;
+    Stage stage_;
+    Move ttMove{};
+    Move killers[2]{};
+    const std::array<int,64>* history{nullptr};
+    MoveList captures, quiets;
+    int cur{0};
+    int badEnd{0}; // bad captures are parked at the front of the capture list
+};
+
+} // namespace eng
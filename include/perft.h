@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "board.h"
+
+namespace eng {
+
+// Move generator verification: leaf counts with bulk counting at depth 1, an optional hash of
+// subtree counts (hashMB=0 disables it) and root moves split across threads.
+struct Perft {
+    static uint64_t count(const Board& b, int depth, int threads = 1, size_t hashMB = 0);
+    static uint64_t divide(const Board& b, int depth, int threads = 1, size_t hashMB = 0); // prints per root move counts
+    static int suite(int threads = 1); // standard positions against known counts; returns the number of failures
+};
+
+} // namespace eng
@@ -1,10 +1,18 @@
 #pragma once
+#include <algorithm>
 #include <atomic>
+#include <iosfwd>
 #include <optional>
 #include <array>
+#include <memory>
+#include <vector>
 #include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 #include "board.h"
+#include "eval.h"
+#include "timeman.h"
 #include "tt.h"
 
 namespace eng {
@@ -12,35 +20,117 @@ namespace eng {
 struct SearchResult {
     int score{0};
     Move best{};
+    Move ponder{}; // expected reply: second move of the best line
 };
 
+// One MultiPV line: a root move, its score and the principal variation starting with it.
+struct RootLine {
+    Move move{};
+    int score{0};
+    std::vector<Move> pv;
+};
+
+#ifdef NOX_STATS
+constexpr bool STATS_ENABLED = true;
+#else
+constexpr bool STATS_ENABLED = false;
+#endif
+
+// Pruning and ordering counters for tuning. Only counted in builds configured with NOX_STATS;
+// otherwise inc() is empty and the counters stay zero.
+struct SearchStats {
+    enum Counter {
+        Nodes, QNodes, TTProbes, TTHits, TTCutoffs, NullTries, NullCutoffs, FailHighs, FailHighsFirst,
+        LmrSearches, LmrResearches, SeePrunes, FutilityPrunes, LmpPrunes, QDeltaPrunes, QSeePrunes, COUNT
+    };
+    std::array<uint64_t, COUNT> c{};
+
+    void inc(Counter k){ if constexpr(STATS_ENABLED) ++c[k]; }
+    void add(const SearchStats& o){ for(int i=0; i<COUNT; ++i) c[i] += o.c[i]; }
+};
+
+// Everything one search thread owns. Threads share only the TT, the eval cache and the stop flag.
+struct SearchThread {
+    static constexpr int MAX_PLY = 128;
+    int id{0};
+    History hist;
+    std::array<std::array<Move,2>, MAX_PLY> killers{}; // two killer moves per ply
+    std::array<std::array<int,64>, 2> history{}; // side index 0=w,1=b; from*8+to%8 simplified: use [from%64]
+    std::atomic<uint64_t> nodes{0}; // written only by the owning thread, summed without locks
+    Move best{};
+    std::vector<Move> bestPV; // of the last completed iteration; best is its first move
+    int bestScore{0};
+    int completedDepth{0};
+    uint64_t rootNodes{0}, bestMoveNodes{0}; // last root search: its nodes and those under its best move
+    int pollCountdown{0}; // nodes until this thread next looks at the clock and the node limit
+    int selDepth{0}; // deepest ply reached in the current iteration
+    SearchStats stats;
+    // triangular PV table: pv[ply][ply..pvLen[ply]) is the best line found from ply in the current node
+    std::array<std::array<Move, MAX_PLY>, MAX_PLY> pv{};
+    std::array<int, MAX_PLY> pvLen{};
+
+    void updatePV(int ply, Move m){ // m followed by the child's line
+        pv[ply][ply] = m;
+        for(int i = ply + 1; i < pvLen[ply + 1]; ++i) pv[ply][i] = pv[ply + 1][i];
+        pvLen[ply] = std::max(ply + 1, pvLen[ply + 1]);
+    }
+
+    void countNode(){ nodes.store(nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+};
+
+// Lazy SMP: every thread runs its own iterative deepening on its own copy of the position, with
+// helper threads skipping depths so they spread over the tree; they cooperate through the TT.
+// Helpers are long-lived: setThreads() starts them and they sleep on a condition variable between searches.
 class Searcher {
 public:
+    Searcher();
+    ~Searcher();
+    Searcher(const Searcher&) = delete;
+    Searcher& operator=(const Searcher&) = delete;
+
     int maxDepth{10};
     std::atomic<bool> stop{false};
     int contempt{0}; // centipawns bias for drawish positions
     TT tt;
-    size_t nodes{0};
-    std::chrono::steady_clock::time_point deadline;
-    std::chrono::steady_clock::time_point softDeadline;
-    int threads{1};
-    std::atomic<bool> parallelRoot{false};
+    int multiPV{1};        // lines reported per iteration
+    uint64_t nodeLimit{0}; // go nodes; 0 = none
+    std::atomic<bool> pondering{false}; // set before search() for go ponder: no clock until ponderhit()
 
-    SearchResult search(Board& b, int timeMs = 1000);
+    SearchResult search(Board& b, TimeLimits tl); // clear stop first; a stop set before it starts is honoured
+    SearchResult search(Board& b, int timeMs = 1000){ return search(b, TimeManager::fixed(timeMs, 0)); }
+    void ponderhit(); // restart the clock from now; the search itself carries on (safe during a search)
+    void setThreads(int n); // must not be called during a search
+    int threadCount() const { return threads; }
+    void clear(); // forget the hash table, killers and history (new game, bench)
+    uint64_t nodes() const; // all threads, current or last search
+    void printStats(std::ostream& os) const; // last search, all threads, as info string lines
 
 private:
-    static constexpr int MAX_PLY = 128;
-    std::array<std::array<Move,2>, MAX_PLY> killers{}; // two killer moves per ply
-    std::array<std::array<int,64>, 2> history{}; // side index 0=w,1=b; from*8+to%8 simplified: use [from%64]
-    std::mutex khMutex; // protects killers/history updates when threaded
+    std::vector<std::unique_ptr<SearchThread>> workers; // kept across searches
+    int threads{0};
+    std::vector<std::thread> pool; // pool[i] drives workers[i+1]; the caller of search() drives workers[0]
+    std::mutex poolMutex;
+    std::condition_variable poolCv;  // wakes helpers for a new search, and the main thread when they finish
+    uint64_t searchId{0};            // bumped per search; a helper runs once for each value it sees
+    int helpersRunning{0};
+    bool poolExit{false};
+    const Board* root{nullptr};      // position of the current search, read by the helpers
+    mutable EvalCache evalCache;
+    std::chrono::steady_clock::time_point startTime;
+    TimeLimits limits;   // of the current search, counted from clockStart; written only by search()
+    std::atomic<std::chrono::steady_clock::rep> clockStart{0}; // ticks at search start, or at ponderhit
 
-    int quiesce(Board& b, int alpha, int beta, int ply);
-    int searchRec(Board& b, int depth, int alpha, int beta, int ply);
+    void idleLoop(SearchThread& t, uint64_t seen); // seen: last searchId already handled
+    void iterate(SearchThread& t, const Board& root);
+    int searchRoot(SearchThread& t, Board& b, int depth, int alpha, int beta, Move& best, const std::vector<Move>& skip);
+    int quiesce(SearchThread& t, Board& b, int alpha, int beta, int ply);
+    int searchRec(SearchThread& t, Board& b, int depth, int alpha, int beta, int ply);
     int evalWithContempt(const Board& b) const;
-    std::string buildPV(Board& b, int maxLen = 40);
-    inline bool timeUp() const { return std::chrono::steady_clock::now() >= deadline; }
-    inline bool timeUpSoft() const { return std::chrono::steady_clock::now() >= softDeadline; }
-    bool badCaptureHeuristic(const Board& b, const Move& m, int stand) const;
+    double clockMs() const; // ms on the clock since clockStart
+    // pondering is checked first: ponderhit() publishes the new clock start before clearing it
+    bool timeUp() const;
+    bool limitReached(SearchThread& t); // amortized timeUp()/nodeLimit check for the hot paths
+    bool pastOptimum(double scale) const; // between iterations: has the scaled optimum been used up
 };
 
 } // namespace eng
@@ -0,0 +1,21 @@
+#pragma once
+
+namespace eng {
+
+// Time for one move in ms: the search aims to stop around optimum, scaled by how settled the
+// root looks, and never runs past maximum.
+struct TimeLimits {
+    int optimum{0};
+    int maximum{0};
+};
+
+struct TimeManager {
+    // clock and increment of the side to move; movestogo 0 means the rest of the game
+    static TimeLimits allocate(int time, int inc, int movestogo, int moveOverhead);
+    static TimeLimits fixed(int movetime, int moveOverhead); // go movetime: spend all of it
+    // factor on optimum after an iteration, from how often the best move changed (decayed count),
+    // how far the score fell since the previous iteration, and the share of root nodes the best move took
+    static double scale(double bestMoveChanges, int scoreDrop, double bestMoveNodeShare);
+};
+
+} // namespace eng
@@ -1,8 +1,8 @@
 #pragma once
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
-#include <vector>
-#include <cstring>
-#include <mutex>
+#include <string>
 #include "types.h"
 
 namespace eng {
@@ -17,46 +17,75 @@ struct TTEntry {
     Move best{};
 };
 
+// Shared by all search threads without locks. The table is an array of 64-byte clusters of four
+// 16-byte slots; each slot keeps the packed entry next to key^data, so a slot torn by concurrent
+// writers fails the key check on probe and reads as a miss. Entries carry the generation of the
+// search that wrote them, and stores evict the slot with the lowest depth minus age.
 class TT {
 public:
+    static constexpr int CLUSTER_SIZE = 4;
+
     TT() = default;
-    void resizeMB(size_t mb){
-        size_t bytes = mb * 1024ull * 1024ull;
-        size_t n = bytes / sizeof(TTEntry);
-        if(n < 1024) n = 1024;
-        table.assign(n, {});
-        mask = n - 1;
-        // if not power of two, we'll handle modulo
-        mod = ( (n & (n-1))==0 ) ? 0 : n;
-    }
+    ~TT(){ release(); }
+    TT(const TT&) = delete;
+    TT& operator=(const TT&) = delete;
+
+    // 2 MB aligned, huge pages where the OS offers them; false if the memory is not available,
+    // in which case the current table is kept
+    bool resizeMB(size_t mb, int threads = 1);
+    void clear(int threads = 1);               // zeroes the table split across threads
+    void newSearch(){ if(++generation == 0) generation = 1; } // once per go, ages everything stored before
+    size_t sizeMB() const { return clusterCount * sizeof(Cluster) >> 20; }
+    int hashfull() const;             // permille of sampled slots written by the current search
+
+    // Raw table image behind a versioned header; load only accepts a file written with the same
+    // entry format and table size, and fills err with the reason otherwise.
+    bool save(const std::string& path, std::string& err) const;
+    bool load(const std::string& path, std::string& err);
+
     bool probe(uint64_t key, TTEntry& out) const{
-        if(table.empty()) return false;
-        std::lock_guard<std::mutex> lock(mtx);
-        const TTEntry& e = at(key);
-        if(e.key == key){ out = e; return true; }
+        if(!table) return false;
+        const Cluster& c = cluster(key);
+        for(const Slot& s : c.slots){
+            uint64_t d = s.data.load(std::memory_order_relaxed);
+            if((s.keyXorData.load(std::memory_order_relaxed) ^ d) != key || !d) continue;
+            out = unpack(key, d);
+            return true;
+        }
         return false;
     }
-    void store(uint64_t key, int depth, int score, Bound bnd, const Move& best){
-        if(table.empty()) return;
-        std::lock_guard<std::mutex> lock(mtx);
-        TTEntry e; e.key=key; e.depth=(int8_t)depth; e.score=(int16_t)score; e.bound=(uint8_t)bnd; e.best=best;
-        TTEntry& dst = ref(key);
-        // replace if deeper or empty
-        if(dst.key==0 || depth >= dst.depth) dst = e;
-    }
+    void store(uint64_t key, int depth, int score, Bound bnd, const Move& best);
+    void prefetch(uint64_t key) const{ if(table) __builtin_prefetch(&cluster(key)); } // issue before the probe is needed
+
 private:
-    std::vector<TTEntry> table;
-    size_t mask{0};
-    size_t mod{0};
-    mutable std::mutex mtx;
-    const TTEntry& at(uint64_t key) const{
-        if(mod) return table[key % mod];
-        return table[key & mask];
+    // no member initializers: the table is zeroed in bulk by clear(), not slot by slot
+    struct Slot {
+        std::atomic<uint64_t> keyXorData;
+        std::atomic<uint64_t> data; // score:16 depth:8 bound:8 move:16 generation:8, 0 when empty
+    };
+    struct alignas(64) Cluster {
+        Slot slots[CLUSTER_SIZE];
+    };
+    Cluster* table{nullptr};
+    size_t clusterCount{0};
+    size_t allocBytes{0};
+    uint8_t generation{1}; // never 0, so a stored entry is never all-zero
+
+    static uint64_t pack(int16_t score, int8_t depth, Bound bnd, Move best, uint8_t gen){
+        return uint64_t(uint16_t(score)) | uint64_t(uint8_t(depth)) << 16 | uint64_t(bnd) << 24
+             | uint64_t(best.data) << 32 | uint64_t(gen) << 48;
+    }
+    static TTEntry unpack(uint64_t key, uint64_t d){
+        TTEntry e; e.key=key; e.score=int16_t(d); e.depth=int8_t(d >> 16); e.bound=uint8_t(d >> 24); e.best=Move{uint16_t(d >> 32)};
+        return e;
     }
-    TTEntry& ref(uint64_t key){
-        if(mod) return table[key % mod];
-        return table[key & mask];
+    // multiply-shift maps the key onto any table size without a division
+    const Cluster& cluster(uint64_t key) const{
+        __extension__ using u128 = unsigned __int128;
+        return table[size_t((u128(key) * u128(clusterCount)) >> 64)];
     }
+    Cluster& cluster(uint64_t key){ return const_cast<Cluster&>(static_cast<const TT&>(*this).cluster(key)); }
+    void release();
 };
 
 } // namespace eng
@@ -7,19 +7,56 @@ namespace eng {
 
 using Square = int; // 0..63
 
-enum MoveFlags : uint16_t {
-    CAPTURE   = 1 << 0,
-    EN_PASSANT= 1 << 1,
-    DOUBLE_PAWN=1 << 2,
-    CASTLE    = 1 << 3,
-    PROMOTION = 1 << 4,
+enum Color : int { WHITE = 0, BLACK = 1 };
+inline Color operator~(Color c) { return Color(c ^ 1); }
+
+enum PieceType : int { PAWN = 0, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+
+// centipawn material values shared by eval, SEE and move ordering; the king is never traded
+constexpr int PIECE_VALUE[6] = {100, 320, 330, 500, 900, 0};
+
+// Piece order matches the Zobrist tables: PNBRQKpnbrqk; one byte keeps the mailbox at 64 bytes
+enum Piece : uint8_t {
+    W_PAWN = 0, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
+    B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING,
+    NO_PIECE
+};
+
+inline Piece makePiece(Color c, PieceType t) { return Piece(c * 6 + t); }
+inline PieceType typeOf(Piece p) { return PieceType(p % 6); }
+inline Color colorOf(Piece p) { return Color(p / 6); }
+
+inline char pieceToChar(Piece p) { return p == NO_PIECE ? '.' : "PNBRQKpnbrqk"[p]; }
+inline Piece charToPiece(char c) {
+    switch(c){
+        case 'P': return W_PAWN; case 'N': return W_KNIGHT; case 'B': return W_BISHOP; case 'R': return W_ROOK; case 'Q': return W_QUEEN; case 'K': return W_KING;
+        case 'p': return B_PAWN; case 'n': return B_KNIGHT; case 'b': return B_BISHOP; case 'r': return B_ROOK; case 'q': return B_QUEEN; case 'k': return B_KING;
+        default: return NO_PIECE;
+    }
+}
+
+enum MoveType : uint16_t {
+    NORMAL     = 0,
+    PROMOTION  = 1 << 14,
+    EN_PASSANT = 2 << 14,
+    CASTLING   = 3 << 14, // encoded as the king's move, e.g. e1g1
 };
 
+// 16-bit move: bits 0-5 from, 6-11 to, 12-13 promotion piece (KNIGHT..QUEEN), 14-15 MoveType.
+// Captures and double pushes are read off the board. Trivially constructible; Move{} is the null move.
 struct Move {
-    Square from{0};
-    Square to{0};
-    char promo{0};
-    uint16_t flags{0};
+    uint16_t data;
+
+    static constexpr Move make(Square from, Square to, MoveType t = NORMAL, PieceType promo = KNIGHT){
+        return Move{uint16_t(from | (to << 6) | ((promo - KNIGHT) << 12) | t)};
+    }
+    constexpr Square from() const { return data & 63; }
+    constexpr Square to() const { return (data >> 6) & 63; }
+    constexpr MoveType type() const { return MoveType(data & (3 << 14)); }
+    constexpr PieceType promo() const { return PieceType(((data >> 12) & 3) + KNIGHT); }
+    constexpr bool ok() const { return from() != to(); } // false for Move{}
+    constexpr bool operator==(const Move& o) const { return data == o.data; }
+    constexpr bool operator!=(const Move& o) const { return data != o.data; }
 };
 
 inline std::string sqToCoord(Square sq) {
@@ -39,4 +76,10 @@ inline Square coordToSq(const std::string& s) {
     return r * 8 + f;
 }
 
+inline std::string moveToUci(const Move& m) {
+    std::string s = sqToCoord(m.from()) + sqToCoord(m.to());
+    if(m.type() == PROMOTION) s += "nbrq"[m.promo() - KNIGHT];
+    return s;
+}
+
 } // namespace eng
@@ -1,5 +1,7 @@
 #pragma once
+#include <atomic>
 #include <string>
+#include <thread>
 #include "board.h"
 #include "search.h"
 
@@ -7,24 +9,33 @@ namespace eng {
 
 class UCI {
 public:
+    ~UCI(){ stopSearch(); }
     void loop();
 
 private:
-    Board board;
+    History history; // game moves; declared before the board that records into it
+    Board board{history};
     Searcher searcher;
     bool debug{false};
     int skill{10};
     int threads{1};
+    int moveOverhead{10}; // ms lost per move to the GUI and network, kept off every budget
     bool useBook{true};
     bool useNNUE{false};
     std::string evalFile;
+    std::thread searchThread;              // runs go so the loop keeps reading stop/isready/quit
+    std::atomic<bool> stopRequested{false}; // set by stop/quit; ends an infinite search
+    std::atomic<bool> searching{false};     // from go until its bestmove is written
 
     void cmdPosition(const std::string& line);
     void cmdGo(const std::string& line);
     void cmdSetOption(const std::string& line);
+    void cmdPerft(const std::string& line);
     Move parseUciMove(const std::string& s);
     std::string moveToUci(const Move& m) const;
     bool tryBookMove(Move& out);
+    void waitForSearch(){ if(searchThread.joinable()) searchThread.join(); }
+    void stopSearch(){ stopRequested = true; searcher.stop = true; waitForSearch(); }
 };
 
 } // namespace eng
@@ -0,0 +1,48 @@
+#include "bench.h"
+#include "search.h"
+#include <chrono>
+#include <iostream>
+
+namespace eng {
+
+static const char* BENCH_FENS[] = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+    "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+    "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+    "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+    "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+    "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+    "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+    "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+    "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+    "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+    "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/8 b - - 3 54",
+    "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 80",
+    "3r2k1/p4ppp/8/1p6/8/1P3PP1/P5KP/2R5 w - - 0 30",
+};
+
+uint64_t Bench::run(int depth, int threads, size_t hashMB){
+    Searcher s;
+    if(!s.tt.resizeMB(hashMB)){ std::cout << "bench: cannot allocate " << hashMB << " MB of hash" << std::endl; return 0; }
+    s.setThreads(threads);
+    s.maxDepth = depth;
+    uint64_t total = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for(const char* fen : BENCH_FENS){
+        History h; Board b(h); b.setFEN(fen);
+        s.clear(); // every position starts from the same state so the node count is reproducible
+        std::cout << "position fen " << fen << std::endl;
+        s.stop = false;
+        s.search(b, 10000000); // depth-limited only
+        total += s.nodes();
+    }
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "\n===========================\n"
+              << "Total time (ms) : " << ms << "\n"
+              << "Nodes searched  : " << total << "\n"
+              << "Nodes/second    : " << (ms? total * 1000 / ms : 0) << std::endl;
+    return total;
+}
+
+} // namespace eng
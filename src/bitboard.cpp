@@ -0,0 +1,145 @@
+#include "bitboard.h"
+#include <cstdlib>
+#if defined(__BMI2__) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#endif
+
+namespace eng {
+
+std::array<std::array<Bitboard,64>,2> Attacks::pawn{};
+std::array<Bitboard,64> Attacks::knight{};
+std::array<Bitboard,64> Attacks::king{};
+std::array<std::array<Bitboard,64>,8> Attacks::rays{};
+std::array<std::array<Bitboard,64>,64> Attacks::between{};
+std::array<std::array<Bitboard,64>,64> Attacks::line{};
+std::array<Magic,64> Attacks::bishopMagics{};
+std::array<Magic,64> Attacks::rookMagics{};
+bool Attacks::usePext = false;
+
+// per-square slices sized 2^relevant-bits (rook 102400, bishop 5248 entries in total)
+static Bitboard rookTable[0x19000];
+static Bitboard bishopTable[0x1480];
+
+// file/rank steps for N,NE,E,SE,S,SW,W,NW; directions 0..3 increase the square index
+static const int DIR_DF[8] = {0, 1, 1, 1, 0,-1,-1,-1};
+static const int DIR_DR[8] = {1, 1, 0,-1,-1,-1, 0, 1};
+static const bool DIR_POS[8] = {true, true, true, false, false, false, false, true};
+
+static Bitboard stepBB(Square s, int df, int dr){
+    int f = s % 8 + df, r = s / 8 + dr;
+    if(f < 0 || f > 7 || r < 0 || r > 7) return 0;
+    return sqBB(r * 8 + f);
+}
+
+static Bitboard rayAttacks(Square s, Bitboard occ, int dir){
+    Bitboard a = Attacks::rays[dir][s];
+    Bitboard blockers = a & occ;
+    if(blockers){
+        Square b = DIR_POS[dir] ? lsb(blockers) : msb(blockers);
+        a ^= Attacks::rays[dir][b];
+    }
+    return a;
+}
+
+// reference ray walk; only used to fill the lookup tables
+static Bitboard slidingAttacks(Square s, Bitboard occ, bool diagonal){
+    Bitboard a = 0;
+    for(int d = diagonal ? 1 : 0; d < 8; d += 2) a |= rayAttacks(s, occ, d);
+    return a;
+}
+
+static uint64_t xorshift64star(uint64_t& x){
+    x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+    return x * 2685821657736338717ULL;
+}
+
+// PEXT is microcoded (very slow) on AMD before Zen 3, so only pick it where it is fast
+static bool pextIsFast(){
+#if defined(__BMI2__) && (defined(__GNUC__) || defined(__clang__))
+    if(!__builtin_cpu_supports("bmi2")) return false;
+    unsigned a, b, c, d;
+    if(!__get_cpuid(0, &a, &b, &c, &d)) return false;
+    bool amd = (b == 0x68747541); // "Auth"enticAMD
+    if(!amd) return true;
+    if(!__get_cpuid(1, &a, &b, &c, &d)) return false;
+    unsigned family = ((a >> 8) & 0xF) + ((a >> 20) & 0xFF);
+    return family >= 0x19;
+#else
+    return false;
+#endif
+}
+
+static void initMagics(std::array<Magic,64>& magics, Bitboard* table, bool diagonal){
+    // seeds per rank that find magics quickly (from the well-known Stockfish search)
+    static const uint64_t SEEDS[8] = {728, 10316, 55013, 32803, 12281, 15100, 16645, 255};
+    static Bitboard occupancy[4096], reference[4096];
+    static int epoch[4096], cnt = 0; // shared across calls so stale stamps never look current
+    Bitboard* next = table;
+    for(int s=0; s<64; ++s){
+        Magic& m = magics[s];
+        Bitboard edges = ((RANK_1_BB | RANK_8_BB) & ~rankBB(s / 8)) | ((FILE_A_BB | FILE_H_BB) & ~fileBB(s % 8));
+        m.mask = slidingAttacks(s, 0, diagonal) & ~edges;
+        m.shift = 64 - popcount(m.mask);
+        m.attacks = next;
+
+        // enumerate all subsets of the mask (Carry-Rippler)
+        int size = 0; Bitboard b = 0;
+        do {
+            occupancy[size] = b;
+            reference[size] = slidingAttacks(s, b, diagonal);
+            if(Attacks::usePext) m.attacks[m.index(b)] = reference[size];
+            size++;
+            b = (b - m.mask) & m.mask;
+        } while(b);
+        next += size;
+        if(Attacks::usePext) continue;
+
+        uint64_t seed = SEEDS[s / 8];
+        for(int i = 0; i < size; ){
+            for(m.magic = 0; popcount((m.magic * m.mask) >> 56) < 6; )
+                m.magic = xorshift64star(seed) & xorshift64star(seed) & xorshift64star(seed);
+            // epoch stamps avoid clearing the slice on every failed attempt
+            for(++cnt, i = 0; i < size; ++i){
+                unsigned idx = m.index(occupancy[i]);
+                if(epoch[idx] < cnt){ epoch[idx] = cnt; m.attacks[idx] = reference[i]; }
+                else if(m.attacks[idx] != reference[i]) break;
+            }
+        }
+    }
+}
+
+void Attacks::init(){
+    for(int s=0; s<64; ++s){
+        pawn[WHITE][s] = stepBB(s,-1,1) | stepBB(s,1,1);
+        pawn[BLACK][s] = stepBB(s,-1,-1) | stepBB(s,1,-1);
+        knight[s] = stepBB(s,1,2) | stepBB(s,2,1) | stepBB(s,2,-1) | stepBB(s,1,-2)
+                  | stepBB(s,-1,-2) | stepBB(s,-2,-1) | stepBB(s,-2,1) | stepBB(s,-1,2);
+        king[s] = 0;
+        for(int d=0; d<8; ++d){
+            king[s] |= stepBB(s, DIR_DF[d], DIR_DR[d]);
+            Bitboard r = 0; int f = s % 8, rk = s / 8;
+            for(;;){
+                f += DIR_DF[d]; rk += DIR_DR[d];
+                if(f < 0 || f > 7 || rk < 0 || rk > 7) break;
+                r |= sqBB(rk * 8 + f);
+            }
+            rays[d][s] = r;
+        }
+    }
+    usePext = pextIsFast();
+    initMagics(bishopMagics, bishopTable, true);
+    initMagics(rookMagics, rookTable, false);
+    for(int a=0; a<64; ++a){
+        for(int b=0; b<64; ++b){
+            between[a][b] = 0; line[a][b] = 0;
+            for(int d=0; d<8; ++d){
+                if(!(rays[d][a] & sqBB(b))) continue;
+                between[a][b] = rays[d][a] & ~rays[d][b] & ~sqBB(b);
+                line[a][b] = rays[d][a] | rays[(d + 4) % 8][a] | sqBB(a);
+                break;
+            }
+        }
+    }
+}
+
+} // namespace eng
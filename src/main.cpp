@@ -1,9 +1,22 @@
+#include <cstdlib>
 #include <iostream>
+#include <string>
+#include "bench.h"
+#include "perft.h"
 #include "uci.h"
 #include "zobrist.h"
+#include "bitboard.h"
 
-int main(){
+int main(int argc, char** argv){
     eng::Zobrist::init();
+    eng::Attacks::init();
+    // command-line mode for CTest: nox_engine perftsuite [threads]
+    if(argc > 1 && std::string(argv[1]) == "perftsuite") return eng::Perft::suite(argc > 2 ? std::atoi(argv[2]) : 1) ? 1 : 0;
+    // nox_engine bench [depth] [threads] [hashMB]
+    if(argc > 1 && std::string(argv[1]) == "bench"){
+        eng::Bench::run(argc > 2 ? std::atoi(argv[2]) : 8, argc > 3 ? std::atoi(argv[3]) : 1, argc > 4 ? std::atoi(argv[4]) : 16);
+        return 0;
+    }
     eng::UCI uci;
     uci.loop();
     return 0;
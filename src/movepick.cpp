@@ -0,0 +1,90 @@
+#include "movepick.h"
+#include <utility>
+
+namespace eng {
+
+static int mvv_lva(const Board& b, const Move& m) {
+    int cap = 0;
+    if(m.type() == EN_PASSANT) cap = PIECE_VALUE[PAWN];
+    else if(b.isCapture(m)) cap = PIECE_VALUE[typeOf(b.pieceOn(m.to()))];
+    int att = PIECE_VALUE[typeOf(b.pieceOn(m.from()))];
+    return cap*10 - att;
+}
+
+// selection step: swap the best remaining move into slot cur
+static const ScoredMove& pickBest(MoveList& ml, int cur){
+    int best = cur;
+    for(int i=cur+1; i<ml.size(); ++i) if(ml[i].score > ml[best].score) best = i;
+    std::swap(ml[cur], ml[best]);
+    return ml[cur];
+}
+
+MovePicker::MovePicker(Board& b, const Move& tt, const Move* k, const std::array<int,64>* hist)
+    : b(b), ttMove(tt), history(hist) {
+    if(k){ killers[0] = k[0]; killers[1] = k[1]; }
+    stage_ = (ttMove.ok() && b.isLegal(ttMove)) ? TT_MOVE : GEN_CAPTURES;
+    if(stage_ != TT_MOVE) ttMove = Move{};
+}
+
+MovePicker::MovePicker(Board& b) : b(b), stage_(QS_GEN) {}
+
+bool MovePicker::next(Move& out){
+    for(;;){
+        switch(stage_){
+            case TT_MOVE:
+                stage_ = GEN_CAPTURES;
+                out = ttMove; return true;
+            case GEN_CAPTURES:
+                b.generateCaptures(captures);
+                for(auto& m : captures) m.score = mvv_lva(b, m);
+                cur = 0; badEnd = 0;
+                stage_ = GOOD_CAPTURES; break;
+            case GOOD_CAPTURES:
+                while(cur < captures.size()){
+                    const ScoredMove& m = pickBest(captures, cur++);
+                    if(m == ttMove) continue;
+                    // losing captures go last; the slot they overwrite was already handed out
+                    if(!b.see_ge(m, 0)){ captures[badEnd++] = m; continue; }
+                    out = m; return true;
+                }
+                stage_ = KILLER1; break;
+            case KILLER1:
+            case KILLER2: {
+                const Move& k = killers[stage_ - KILLER1];
+                stage_ = Stage(stage_ + 1);
+                if(!k.ok() || k == ttMove || b.isTactical(k)) break;
+                if(stage_ == GEN_QUIETS && k == killers[0]) break;
+                if(!b.isLegal(k)) break;
+                out = k; return true;
+            }
+            case GEN_QUIETS:
+                b.generateQuiets(quiets);
+                for(auto& m : quiets) m.score = history ? (*history)[m.from()] : 0;
+                cur = 0;
+                stage_ = QUIETS; break;
+            case QUIETS:
+                while(cur < quiets.size()){
+                    const ScoredMove& m = pickBest(quiets, cur++);
+                    if(m == ttMove || m == killers[0] || m == killers[1]) continue;
+                    out = m; return true;
+                }
+                cur = 0;
+                stage_ = BAD_CAPTURES; break;
+            case BAD_CAPTURES:
+                if(cur < badEnd){ out = captures[cur++]; return true; }
+                stage_ = DONE; break;
+            case QS_GEN:
+                b.generateCaptures(captures);
+                for(auto& m : captures) m.score = mvv_lva(b, m);
+                cur = 0;
+                stage_ = QS_CAPTURES; break;
+            case QS_CAPTURES:
+                if(cur < captures.size()){ out = pickBest(captures, cur++); return true; }
+                stage_ = DONE; break;
+            case DONE:
+                return false;
+        }
+    }
+}
+
+} // namespace eng
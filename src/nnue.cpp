@@ -28,20 +28,12 @@ static bool read_vec(std::istream& f, std::vector<float>& v, size_t count){
     return (bool)f.read(reinterpret_cast<char*>(v.data()), sizeof(float)*count);
 }
 
-static inline int orientSq(int sq, char side){
-    if(side=='w') return sq;
+static inline int orientSq(int sq, Color side){
+    if(side==WHITE) return sq;
     // flip both rank and file for a simple side-relative mapping
     return 63 - sq;
 }
 
-static inline int pieceIndex(char p){
-    switch(p){
-        case 'P': return 0; case 'N': return 1; case 'B': return 2; case 'R': return 3; case 'Q': return 4; case 'K': return 5;
-        case 'p': return 6; case 'n': return 7; case 'b': return 8; case 'r': return 9; case 'q': return 10; case 'k': return 11;
-        default: return -1;
-    }
-}
-
 static void build_features(const Board& b, std::vector<float>& x){
     // Expected layout:
     // [0..767): 12*64 piece-square one-hot, side-relative
@@ -51,12 +43,14 @@ static void build_features(const Board& b, std::vector<float>& x){
     // [781]: phase scalar in [0,1]
     const uint32_t expected = 782;
     x.assign(g_inDim ? g_inDim : expected, 0.0f);
-    const auto& brd = b.st.board;
-    char side = b.st.side;
-    // pieces
-    for(int s=0;s<64;++s){ char p=brd[s]; if(p=='.') continue; int pi = pieceIndex(p); if(pi<0) continue; int os = orientSq(s, side); int idx = pi*64 + os; if(idx>=0 && idx<768 && idx<(int)x.size()) x[idx]=1.0f; }
+    Color side = b.st.side;
+    // pieces (Piece order is the feature block order)
+    for(int pi=W_PAWN; pi<=B_KING; ++pi){
+        Bitboard bb = b.st.pieces[pi];
+        while(bb){ int os = orientSq(popLsb(bb), side); int idx = pi*64 + os; if(idx<(int)x.size()) x[idx]=1.0f; }
+    }
     // side to move
-    if(768 < (int)x.size()) x[768] = (side=='w')? 1.0f : 0.0f;
+    if(768 < (int)x.size()) x[768] = (side==WHITE)? 1.0f : 0.0f;
     // castling flags
     if(772 < (int)x.size()){
         int c = b.st.castling; if(c & 1) x[769]=1.0f; if(c & 2) x[770]=1.0f; if(c & 4) x[771]=1.0f; if(c & 8) x[772]=1.0f;
@@ -67,8 +61,8 @@ static void build_features(const Board& b, std::vector<float>& x){
     }
     // phase scalar: based on non-king material
     if(781 < (int)x.size()){
-        auto absVal = [](char p){ switch(p){ case 'P':case 'p': return 1; case 'N':case 'n': return 3; case 'B':case 'b': return 3; case 'R':case 'r': return 5; case 'Q':case 'q': return 9; default: return 0; } }; // coarse
-        int total=0; for(int i=0;i<64;i++){ total += absVal(brd[i]); }
+        static const int absVal[6] = {1, 3, 3, 5, 9, 0}; // coarse
+        int total=0; for(int pi=W_PAWN; pi<=B_KING; ++pi){ total += absVal[typeOf(Piece(pi))] * popcount(b.st.pieces[pi]); }
         float phase = std::fmin(1.0f, total / 78.0f); // 2*(9+2*5+2*3+2*3+8*1)=78 mid-ish
         x[781] = phase;
     }
@@ -0,0 +1,136 @@
+#include "perft.h"
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace eng {
+
+// Subtree counts keyed by position and remaining depth, shared by all perft threads. A slot stores
+// key^count next to the count, so one torn by two writers fails verification instead of lying.
+class PerftHash {
+public:
+    explicit PerftHash(size_t mb){
+        if(!mb) return;
+        size_t n = 1;
+        while(n * 2 * sizeof(Slot) <= mb * 1024ull * 1024ull) n *= 2;
+        slots = std::vector<Slot>(n);
+        mask = n - 1;
+    }
+    bool enabled() const { return !slots.empty(); }
+    bool probe(uint64_t key, int depth, uint64_t& count) const{
+        uint64_t k = mix(key, depth);
+        const Slot& s = slots[k & mask];
+        uint64_t c = s.count.load(std::memory_order_relaxed);
+        if((s.check.load(std::memory_order_relaxed) ^ c) != k) return false;
+        count = c; return true;
+    }
+    void store(uint64_t key, int depth, uint64_t count){
+        uint64_t k = mix(key, depth);
+        Slot& s = slots[k & mask];
+        s.check.store(k ^ count, std::memory_order_relaxed);
+        s.count.store(count, std::memory_order_relaxed);
+    }
+private:
+    struct Slot { std::atomic<uint64_t> check{0}, count{0}; };
+    std::vector<Slot> slots;
+    size_t mask{0};
+    static uint64_t mix(uint64_t key, int depth){ return key ^ (uint64_t(depth) * 0x9E3779B97F4A7C15ULL); }
+};
+
+static uint64_t perftRec(Board& b, int depth, PerftHash& tt){
+    uint64_t n = 0;
+    if(depth >= 2 && tt.enabled() && tt.probe(b.positionKey(), depth, n)) return n;
+    MoveList moves; b.generateLegalMoves(moves);
+    if(depth == 1) return moves.size(); // bulk counting: the leaves are never made
+    for(const auto& m : moves){ b.makeMove(m); n += perftRec(b, depth-1, tt); b.unmakeMove(); }
+    if(tt.enabled()) tt.store(b.positionKey(), depth, n);
+    return n;
+}
+
+// counts below each root move; workers take root moves from a shared index
+static std::vector<uint64_t> rootCounts(const Board& b, const MoveList& moves, int depth, int threads, size_t hashMB){
+    std::vector<uint64_t> counts(moves.size(), 1);
+    if(depth <= 1) return counts;
+    PerftHash tt(hashMB);
+    std::atomic<int> next{0};
+    auto worker = [&](){
+        History h; Board wb = b.fork(h);
+        for(int i; (i = next.fetch_add(1)) < moves.size(); ){
+            wb.makeMove(moves[i]);
+            counts[i] = perftRec(wb, depth-1, tt);
+            wb.unmakeMove();
+        }
+    };
+    if(threads > 1){
+        std::vector<std::thread> pool;
+        for(int t=0; t<threads; ++t) pool.emplace_back(worker);
+        for(auto& th : pool) th.join();
+    } else {
+        worker();
+    }
+    return counts;
+}
+
+static MoveList rootMoves(const Board& b){
+    History h; Board tmp = b.fork(h);
+    MoveList moves; tmp.generateLegalMoves(moves);
+    return moves;
+}
+
+uint64_t Perft::count(const Board& b, int depth, int threads, size_t hashMB){
+    if(depth <= 0) return 1;
+    MoveList moves = rootMoves(b);
+    uint64_t n = 0;
+    for(uint64_t c : rootCounts(b, moves, depth, threads, hashMB)) n += c;
+    return n;
+}
+
+uint64_t Perft::divide(const Board& b, int depth, int threads, size_t hashMB){
+    if(depth <= 0) return 1;
+    MoveList moves = rootMoves(b);
+    std::vector<uint64_t> counts = rootCounts(b, moves, depth, threads, hashMB);
+    uint64_t n = 0;
+    for(int i=0; i<moves.size(); ++i){ std::cout << moveToUci(moves[i]) << ": " << counts[i] << "\n"; n += counts[i]; }
+    std::cout << "\nNodes searched: " << n << std::endl;
+    return n;
+}
+
+int Perft::suite(int threads){
+    struct Case { const char* fen; int depth; uint64_t nodes; };
+    static const Case CASES[] = {
+        {"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6, 119060324},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5, 193690690},
+        {"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 6, 11030083},
+        {"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 4, 422333},
+        {"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 4, 2103487},
+        {"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", 4, 3894594},
+        {"8/8/1k6/2b5/2pP4/8/5K2/8 b - d3 0 1", 6, 1440467},
+        {"8/5bk1/8/2Pp4/8/1K6/8/8 w - d6 0 1", 6, 824064},
+        {"r3k2r/1b4bq/8/8/8/8/7B/R3K2R w KQkq - 0 1", 4, 1274206},
+        {"r3k2r/8/3Q4/8/8/5q2/8/R3K2R b KQkq - 0 1", 4, 1720476},
+        {"2K2r2/4P3/8/8/8/8/8/3k4 w - - 0 1", 6, 3821001},
+        {"8/k1P5/8/1K6/8/8/8/8 w - - 0 1", 7, 567584},
+    };
+    int failures = 0;
+    uint64_t total = 0; long long totalMs = 0;
+    for(const Case& c : CASES){
+        Board b; b.setFEN(c.fen);
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t n = count(b, c.depth, threads, 0); // no hash, so the generator does all the work
+        long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+        total += n; totalMs += ms;
+        bool ok = (n == c.nodes);
+        if(!ok) failures++;
+        std::cout << (ok? "ok   " : "FAIL ") << "d" << c.depth << " " << std::setw(10) << n;
+        if(!ok) std::cout << " (expected " << c.nodes << ")";
+        std::cout << " " << std::setw(6) << ms << " ms  " << c.fen << std::endl;
+    }
+    std::cout << "total " << total << " nodes " << totalMs << " ms " << (totalMs? total * 1000 / totalMs : 0) << " nps, "
+              << failures << " failed" << std::endl;
+    return failures;
+}
+
+} // namespace eng
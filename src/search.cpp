@@ -1,374 +1,433 @@
 #include "search.h"
 #include "eval.h"
+#include "movepick.h"
+#include "nnue.h"
 #include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <limits>
+#include <sstream>
 #include <thread>
-#include <mutex>
 
 namespace eng {
 
-static int pieceVal(char p) {
-    switch (p) {
-        case 'P': return 100;
-        case 'N': return 320;
-        case 'B': return 330;
-        case 'R': return 500;
-        case 'Q': return 900;
-        case 'K': return 0;
-        case 'p': return -100;
-        case 'n': return -320;
-        case 'b': return -330;
-        case 'r': return -500;
-        case 'q': return -900;
-        case 'k': return 0;
-        default: return 0;
+static int pieceVal(Piece p) { return p == NO_PIECE ? 0 : PIECE_VALUE[typeOf(p)]; }
+
+static std::string pvString(const std::vector<Move>& pv){
+    std::string out;
+    for(const Move& m : pv){ if(!out.empty()) out += ' '; out += moveToUci(m); }
+    return out;
+}
+
+double Searcher::clockMs() const{
+    auto start = std::chrono::steady_clock::time_point(std::chrono::steady_clock::duration(clockStart.load()));
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Searcher::timeUp() const{
+    return !pondering && clockMs() >= limits.maximum;
+}
+
+bool Searcher::pastOptimum(double scale) const{
+    if(pondering || limits.optimum >= limits.maximum) return false; // movetime: run to the deadline
+    return clockMs() >= std::min<double>(limits.maximum, limits.optimum * scale);
+}
+
+void Searcher::ponderhit(){
+    // runs on the UCI thread: it only touches atomics, the search reads its limits itself
+    clockStart = std::chrono::steady_clock::now().time_since_epoch().count();
+    pondering = false;
+}
+
+Searcher::Searcher(){ setThreads(1); }
+
+Searcher::~Searcher(){ setThreads(0); }
+
+void Searcher::setThreads(int n){
+    if(!pool.empty()){
+        { std::lock_guard<std::mutex> lk(poolMutex); poolExit = true; }
+        poolCv.notify_all();
+        for(auto& th : pool) th.join();
+        pool.clear();
+        poolExit = false;
     }
+    threads = n;
+    while((int)workers.size() < n){ workers.emplace_back(new SearchThread()); workers.back()->id = (int)workers.size() - 1; }
+    // new helpers count the searches before they existed as seen, or they would wake to a stale root
+    uint64_t current;
+    { std::lock_guard<std::mutex> lk(poolMutex); current = searchId; }
+    for(int i=1; i<n; ++i) pool.emplace_back([this, i, current]{ idleLoop(*workers[i], current); });
 }
 
-static bool inBounds(int s){ return s>=0 && s<64; }
-static bool knightStepOk(int from,int to){ if(!inBounds(to)) return false; int ff=from%8, tf=to%8; int fr=from/8, tr=to/8; int df=std::abs(ff-tf), dr=std::abs(fr-tr); return (df==1&&dr==2)||(df==2&&dr==1); }
-static bool kingStepOkLocal(int from,int to){ if(!inBounds(to)) return false; int df=std::abs(from%8 - to%8), dr=std::abs(from/8 - to/8); return std::max(df,dr)==1; }
-static bool slideOkLocal(int from,int to,int d){ if(!inBounds(to)) return false; int ff=from%8, tf=to%8; int fr=from/8, tr=to/8; if(d== -1 || d==1) return std::abs(tf-ff)==std::abs(to-from); if(d== -9 || d== -7 || d==7 || d==9) return std::abs(tf-ff)==std::abs(tr-fr); if(d== -8 || d==8) return tf==ff; return true; }
-
-static int lvaAttackerValue(const Board& b, int sq, char side){
-    static const int KNIGHT_DIRS[8] = {-17,-15,-10,-6,6,10,15,17};
-    static const int BISHOP_DIRS[4] = {-9,-7,7,9};
-    static const int ROOK_DIRS[4]   = {-8,-1,1,8};
-    static const int KING_DIRS[8]   = {-9,-8,-7,-1,1,7,8,9};
-    const auto& brd = b.st.board;
-    int best = 1e9;
-    for(int f=0; f<64; ++f){ char p = brd[f]; if(p=='.') continue; if((side=='w' && !(p>='A'&&p<='Z')) || (side=='b' && !(p>='a'&&p<='z'))) continue;
-        char up = std::toupper(p);
-        bool attacks=false;
-        if(up=='N'){
-            for(int d:KNIGHT_DIRS){ int to=f+d; if(knightStepOk(f,to) && to==sq){ attacks=true; break; } }
-        } else if(up=='B' || up=='Q'){
-            for(int d:BISHOP_DIRS){ int to=f+d; while(inBounds(to) && slideOkLocal(f,to,d)){ char q=brd[to]; if(to==sq){ attacks=true; break; } if(q!='.') break; to+=d; } if(attacks) break; }
-        } else if(up=='R' || up=='Q'){
-            for(int d:ROOK_DIRS){ int to=f+d; while(inBounds(to) && slideOkLocal(f,to,d)){ char q=brd[to]; if(to==sq){ attacks=true; break; } if(q!='.') break; to+=d; } if(attacks) break; }
-        } else if(up=='K'){
-            for(int d:KING_DIRS){ int to=f+d; if(kingStepOkLocal(f,to) && to==sq){ attacks=true; break; } }
-        } else if(up=='P'){
-            int dir = (p=='P')? 8 : -8; // white pawns attack up (sq-from == 7 or 9)
-            int df1 = (p=='P')? 7 : -7; int df2 = (p=='P')? 9 : -9; if(f+df1==sq || f+df2==sq) attacks=true;
+void Searcher::idleLoop(SearchThread& t, uint64_t seen){
+    for(;;){
+        {
+            std::unique_lock<std::mutex> lk(poolMutex);
+            poolCv.wait(lk, [&]{ return poolExit || searchId != seen; });
+            if(poolExit) return;
+            seen = searchId;
         }
-        if(attacks){ int v = std::abs(pieceVal(p)); if(v < best) best = v; }
+        iterate(t, *root);
+        {
+            std::lock_guard<std::mutex> lk(poolMutex);
+            --helpersRunning;
+        }
+        poolCv.notify_all();
     }
-    return best==1e9? 0 : best;
 }
 
-static std::string moveToUciPV(const Move& m) {
-    std::string s = sqToCoord(m.from) + sqToCoord(m.to);
-    if ((m.flags & PROMOTION) && m.promo) s += (char)std::tolower(m.promo);
-    return s;
-}
+SearchResult Searcher::search(Board& b, TimeLimits tl){
+    // stop is not reset here: the caller clears it before the search can be asked to stop
+    tt.newSearch();
+    startTime = std::chrono::steady_clock::now();
+    limits = tl;
+    clockStart = startTime.time_since_epoch().count();
 
-std::string Searcher::buildPV(Board& b, int maxLen) {
-    std::string out;
-    Board bb = b; // copy
-    for (int i = 0; i < maxLen; i++) {
-        TTEntry e{};
-        uint64_t key = bb.positionKey();
-        if (!tt.probe(key, e)) break;
-        Move m = e.best;
-        if (!(m.from || m.to)) break;
-        if (!bb.makeMove(m)) break;
-        if (!out.empty()) out.push_back(' ');
-        out += moveToUciPV(m);
+    for(int i=0; i<threads; ++i){
+        SearchThread& t = *workers[i];
+        t.nodes = 0; t.best = Move{}; t.bestPV.clear(); t.bestScore = 0; t.completedDepth = 0; t.pollCountdown = 0; t.stats = {};
     }
-    return out;
+
+    if(threads > 1){
+        {
+            std::lock_guard<std::mutex> lk(poolMutex);
+            root = &b; helpersRunning = threads - 1; ++searchId;
+        }
+        poolCv.notify_all();
+        iterate(*workers[0], b);
+        stop = true; // the main thread decides when the search is over
+        std::unique_lock<std::mutex> lk(poolMutex);
+        poolCv.wait(lk, [&]{ return helpersRunning == 0; });
+    } else {
+        iterate(*workers[0], b);
+    }
+
+    // a helper that completed a deeper iteration than the main thread is trusted over it
+    const SearchThread* bestThread = workers[0].get();
+    for(int i=1; i<threads; ++i){
+        const SearchThread& t = *workers[i];
+        if(t.best.ok() && t.completedDepth > bestThread->completedDepth && t.bestScore >= bestThread->bestScore) bestThread = &t;
+    }
+    SearchResult res; res.score = bestThread->bestScore; res.best = bestThread->best;
+    if(!res.best.ok()){
+        // stopped before any thread had a move (tiny node limit, immediate stop): play a legal one
+        MoveList legal; b.generateLegalMoves(legal);
+        if(legal.size()) res.best = legal[0];
+    }
+    if(bestThread->bestPV.size() > 1) res.ponder = bestThread->bestPV[1];
+    return res;
 }
 
-bool Searcher::badCaptureHeuristic(const Board& b, const Move& m, int /*stand*/) const {
-    if (!(m.flags & (CAPTURE | EN_PASSANT))) return false;
-    const auto& brd = b.st.board;
-    char attacker = brd[m.from];
-    char captured = (m.flags & EN_PASSANT) ? (b.st.side == 'w' ? 'p' : 'P') : brd[m.to];
-    int attV = std::abs(pieceVal(attacker));
-    int capV = std::abs(pieceVal(captured));
-    // Quick MVV-LVA gate: if we win material on face value, accept
-    if (capV >= attV) return false;
-    // Light square safety check: after move, is our piece attacked on the target square?
-    Board tb = b; if(!tb.makeMove(m)) return true; // illegal -> bad
-    char opp = (tb.st.side=='w')?'b':'w'; // side to move is opponent after makeMove
-    bool attacked = tb.squareAttacked(m.to, opp);
-    tb.unmakeMove();
-    if(!attacked) return false;
-    // Quick LVA-based exchange check: can opponent recapture cheaply?
-    int oppLVA = lvaAttackerValue(tb, m.to, opp);
-    if(oppLVA==0) return false; // no recapture
-    // If opponent's cheapest attacker is less valuable than the gain, likely bad
-    return (capV - oppLVA) < -20;
+// Reading the clock on every node costs a few percent, so each thread only polls every POLL_NODES
+// nodes (about a millisecond); a node limit shortens the interval so it overshoots by little.
+bool Searcher::limitReached(SearchThread& t){
+    static constexpr int POLL_NODES = 1024;
+    if(--t.pollCountdown > 0) return false;
+    t.pollCountdown = nodeLimit? (int)std::clamp<uint64_t>(nodeLimit / (64 * threads), 1, POLL_NODES) : POLL_NODES;
+    return timeUp() || (nodeLimit && nodes() >= nodeLimit);
 }
 
-static int mvv_lva(const Board& b, const Move& m) {
-    const auto& brd = b.st.board;
-    int cap = 0;
-    if (m.flags & EN_PASSANT) cap = std::abs(pieceVal('p'));
-    else if (m.flags & CAPTURE) cap = std::abs(pieceVal(brd[m.to]));
-    if(m.flags & EN_PASSANT) cap = std::abs(pieceVal('p'));
-    else if(m.flags & CAPTURE) cap = std::abs(pieceVal(brd[m.to]));
-    int att = std::abs(pieceVal(brd[m.from]));
-    return cap*10 - att;
+void Searcher::printStats(std::ostream& os) const{
+    if(!STATS_ENABLED){ os << "info string stats not compiled in (configure with -DNOX_STATS=ON)" << std::endl; return; }
+    SearchStats s;
+    for(int i=0; i<threads && i<(int)workers.size(); ++i) s.add(workers[i]->stats);
+    auto pct = [](uint64_t a, uint64_t b){ std::ostringstream o; o.setf(std::ios::fixed); o.precision(1); o << (b? 100.0 * a / b : 0.0) << "%"; return o.str(); };
+    const auto& c = s.c;
+    uint64_t all = c[SearchStats::Nodes] + c[SearchStats::QNodes];
+    std::ostringstream out;
+    out << "info string nodes " << all << " qsearch " << pct(c[SearchStats::QNodes], all) << "\n"
+        << "info string tt probes " << c[SearchStats::TTProbes] << " hits " << pct(c[SearchStats::TTHits], c[SearchStats::TTProbes])
+        << " cutoffs " << pct(c[SearchStats::TTCutoffs], c[SearchStats::TTProbes]) << "\n"
+        << "info string null tries " << c[SearchStats::NullTries] << " cutoffs " << pct(c[SearchStats::NullCutoffs], c[SearchStats::NullTries]) << "\n"
+        << "info string fail highs " << c[SearchStats::FailHighs] << " on first move " << pct(c[SearchStats::FailHighsFirst], c[SearchStats::FailHighs]) << "\n"
+        << "info string lmr searches " << c[SearchStats::LmrSearches] << " researched " << pct(c[SearchStats::LmrResearches], c[SearchStats::LmrSearches]) << "\n"
+        << "info string pruned see " << c[SearchStats::SeePrunes] << " futility " << c[SearchStats::FutilityPrunes] << " lmp " << c[SearchStats::LmpPrunes]
+        << " qdelta " << c[SearchStats::QDeltaPrunes] << " qsee " << c[SearchStats::QSeePrunes] << "\n";
+    os << out.str() << std::flush;
 }
 
-SearchResult Searcher::search(Board& b, int timeMs){
-    stop = false;
-    nodes = 0;
-    auto start = std::chrono::steady_clock::now();
-    deadline = start + std::chrono::milliseconds(timeMs);
-    softDeadline = start + std::chrono::milliseconds((timeMs*90)/100);
+uint64_t Searcher::nodes() const{
+    uint64_t n = 0;
+    for(int i=0; i<threads && i<(int)workers.size(); ++i) n += workers[i]->nodes.load(std::memory_order_relaxed);
+    return n;
+}
 
-    Move best{}; int bestScore = 0; int lastScore = 0;
-    auto timeUpLocal = [&]{ return timeUp(); };
+// depth skipping for helper threads (the classic Lazy SMP pattern): thread i skips blocks of
+// SKIP_SIZE depths, offset by SKIP_PHASE, so the helpers are not all on the same iteration
+static const int SKIP_SIZE[]  = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+static const int SKIP_PHASE[] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
 
-    int alphaRoot = -10000000, betaRoot = 10000000;
+void Searcher::iterate(SearchThread& t, const Board& root){
+    Board b = root.fork(t.hist);
+    int lastScore = 0;
+    double bestMoveChanges = 0; // decayed count of iterations that changed the best move
+    // MultiPV: the main thread searches line k with lines 0..k-1 excluded at the root, each with its
+    // own aspiration window around last iteration's score; helpers only ever look for the best line
+    int lineCount = t.id == 0 ? std::max(1, multiPV) : 1;
+    std::vector<RootLine> lines, prevLines; // best first
     for(int depth=1; depth<=maxDepth; ++depth){
-        if(stop || timeUpLocal()) break;
-        // aspiration window around lastScore
-        int window = 30; // cp
-        int alpha = std::max(alphaRoot, lastScore - window);
-        int beta  = std::min(betaRoot, lastScore + window);
-        // Root move generation and ordering
-        auto moves = b.generateLegalMoves();
-        if(moves.empty()){
-            // no legal move: mate or stalemate
-            best = Move{}; bestScore = 0; break;
+        if(stop || timeUp()) break;
+        if(t.id > 0){
+            int i = (t.id - 1) % 20;
+            if(((depth + SKIP_PHASE[i]) / SKIP_SIZE[i]) % 2) continue;
         }
-        TTEntry e{}; Move ttMove = {}; uint64_t keyRoot = b.positionKey(); if(tt.probe(keyRoot, e)) ttMove = e.best;
-        std::sort(moves.begin(), moves.end(), [&](const Move& a, const Move& bmv){
-            auto scoreMove = [&](const Move& m){
-                int s=0;
-                if(m.from==ttMove.from && m.to==ttMove.to) s+=1'000'000;
-                if(m.flags&(CAPTURE|EN_PASSANT|PROMOTION)){
-                    s+=100'000 + mvv_lva(b,m);
-                    if(badCaptureHeuristic(b,m,0)) s -= 50'000;
-                }
-                return s;
-            };
-            return scoreMove(a) > scoreMove(bmv);
-        });
-
-        std::atomic<int> idx{0};
-        std::mutex mtx;
-        int localBestScore = -10000000; Move localBest{};
-
-        auto worker = [&](){
-            // Each thread works on moves
+        t.selDepth = 0;
+        Move best{}; int score = 0; std::vector<Move> pv;
+        double share = 0.0; // of the best line's root nodes under its move, for the time manager
+        std::vector<Move> skip;
+        lines.clear();
+        for(int k=0; k<lineCount; ++k){
+            Move mv = k < (int)prevLines.size() ? prevLines[k].move : Move{};
+            if(std::find(skip.begin(), skip.end(), mv) != skip.end()) mv = Move{};
+            int last = k < (int)prevLines.size() ? prevLines[k].score : lastScore;
+            // aspiration window around the last score, widened on a fail
+            int window = 30; // cp
+            int alpha = depth >= 4 ? last - window : -10000000;
+            int beta  = depth >= 4 ? last + window : 10000000;
+            int sc;
             for(;;){
-                int i = idx.fetch_add(1);
-                if(i >= (int)moves.size() || stop || timeUpLocal()) break;
-                const Move m = moves[i];
-                Board tb = b; // thread-local copy
-                if(!tb.makeMove(m)) continue;
-                int nextDepth = depth - 1;
-                int aSnap;
-                {
-                    std::lock_guard<std::mutex> lock(mtx);
-                    aSnap = alpha;
-                }
-                int score = -searchRec(tb, nextDepth, -beta, -aSnap, 1);
-                std::lock_guard<std::mutex> lock(mtx);
-                if(score > localBestScore){ localBestScore = score; localBest = m; }
-                if(score > alpha){ alpha = score; best = m; bestScore = score; }
-                if(alpha >= beta){ stop = stop || timeUpLocal(); break; }
+                sc = searchRoot(t, b, depth, alpha, beta, mv, skip);
+                if(stop || !mv.ok()) break; // no move left to search for this line
+                if(sc <= alpha){ alpha = std::max(-10000000, alpha - window); }
+                else if(sc >= beta){ beta = std::min(10000000, beta + window); }
+                else break;
+                window *= 4;
             }
-        };
-
-        if(threads > 1){
-            std::vector<std::thread> pool; pool.reserve(threads);
-            for(int t=0; t<threads; ++t) pool.emplace_back(worker);
-            for(auto& th : pool) th.join();
-        } else {
-            worker();
+            std::vector<Move> linePV(t.pv[0].begin(), t.pv[0].begin() + t.pvLen[0]);
+            if(k == 0){ best = mv; score = sc; pv = linePV; share = t.rootNodes ? (double)t.bestMoveNodes / t.rootNodes : 0.0; }
+            if(stop || !mv.ok()) break; // out of time, or fewer legal moves than lines
+            lines.push_back({mv, sc, std::move(linePV)}); skip.push_back(mv);
         }
+        // a search cut short by time keeps the previous iteration, unless there is none yet
+        if(stop && t.completedDepth > 0) break;
+        if(!best.ok()){ t.best = Move{}; t.bestScore = 0; break; } // no legal move: mate or stalemate
+        // a later line can come back above an earlier one; report and play them in score order
+        std::stable_sort(lines.begin(), lines.end(), [](const RootLine& x, const RootLine& y){ return x.score > y.score; });
+        if(!lines.empty()){ best = lines[0].move; score = lines[0].score; pv = lines[0].pv; }
+        prevLines = lines;
+        bestMoveChanges = bestMoveChanges / 2 + (t.completedDepth && best != t.best);
+        int scoreDrop = t.completedDepth ? lastScore - score : 0;
+        t.best = best; t.bestPV = pv; t.bestScore = lastScore = score; t.completedDepth = depth;
+        if(t.id != 0) continue;
 
-        lastScore = bestScore = (best.from||best.to) ? std::max(localBestScore, bestScore) : localBestScore;
-        if(!(best.from||best.to)) best = localBest;
-        // Aspiration fail-low/high handling: widen window and redo serial root if needed
-        bool failLow  = bestScore <= alpha;
-        bool failHigh = bestScore >= beta;
-        if((failLow || failHigh) && !stop && !timeUpLocal()){
-            int widen = failHigh ? 200 : 200; // widen both sides generously
-            int a2 = -10000000, b2 = 10000000;
-            if(failLow){ a2 = -10000000; b2 = alpha + widen; }
-            if(failHigh){ a2 = beta - widen; b2 = 10000000; }
-            Move best2{}; int bs2 = -10000000;
-            // Serial re-search with widened window
-            for(size_t i=0;i<moves.size() && !stop && !timeUpLocal(); ++i){
-                const Move m = moves[i];
-                Board tb = b;
-                if(!tb.makeMove(m)) continue;
-                int score;
-                int nextDepth = depth - 1;
-                if(i==0) score = -searchRec(tb, nextDepth, -b2, -a2, 1);
-                else {
-                    score = -searchRec(tb, nextDepth, -a2-1, -a2, 1);
-                    if(score > a2 && !stop){ score = -searchRec(tb, nextDepth, -b2, -a2, 1); }
-                }
-                if(score > bs2){ bs2 = score; best2 = m; }
-                if(score > a2){ a2 = score; best2 = m; }
-                if(a2 >= b2) break;
-            }
-            if(best2.from||best2.to){ best = best2; bestScore = bs2; lastScore = bs2; }
+        int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-startTime).count();
+        uint64_t n = nodes();
+        long long nps = elapsed>0 ? (long long)n * 1000LL / elapsed : 0LL;
+        if(lines.empty()) lines.push_back({best, score, pv}); // first iteration cut short
+        // one write per line, so it cannot interleave with replies from the UCI thread
+        std::ostringstream info;
+        for(size_t k=0; k<lines.size(); ++k)
+            info << "info depth "<<depth
+                 << " seldepth "<<t.selDepth
+                 << " multipv "<<k+1
+                 << " score cp "<<lines[k].score
+                 << " time "<<elapsed
+                 << " nodes "<<n
+                 << " nps "<<nps
+                 << " hashfull "<<tt.hashfull()
+                 << " pv "<<pvString(lines[k].pv)
+                 << "\n";
+        std::cout << info.str() << std::flush;
+        // an unsettled root earns more of the budget, a clear one less
+        if(stop || timeUp() || (depth>=3 && pastOptimum(TimeManager::scale(bestMoveChanges, scoreDrop, share)))) break;
+    }
+}
+
+int Searcher::searchRoot(SearchThread& t, Board& b, int depth, int alpha, int beta, Move& best, const std::vector<Move>& skip){
+    t.countNode();
+    TTEntry e{}; Move ttMove = {};
+    uint64_t key = b.positionKey();
+    if(tt.probe(key, e)) ttMove = e.best;
+    // the previous iteration's best move leads even if the TT slot was overwritten
+    if(best.ok()) ttMove = best;
+    MovePicker mp(b, ttMove, t.killers[0].data(), &t.history[b.st.side]);
+    int origAlpha = alpha, bestScore = -10000000;
+    Move m, bestMove{}, firstMove{};
+    bool first = true;
+    t.pvLen[0] = 0;
+    uint64_t rootStart = t.nodes.load(std::memory_order_relaxed);
+    while(mp.next(m)){
+        if(!skip.empty() && std::find(skip.begin(), skip.end(), m) != skip.end()) continue;
+        if(!firstMove.ok()) firstMove = m;
+        uint64_t moveStart = t.nodes.load(std::memory_order_relaxed);
+        b.makeMove(m);
+        int score;
+        if(first) score = -searchRec(t, b, depth - 1, -beta, -alpha, 1);
+        else {
+            score = -searchRec(t, b, depth - 1, -alpha-1, -alpha, 1);
+            if(score > alpha && score < beta) score = -searchRec(t, b, depth - 1, -beta, -alpha, 1);
         }
-        auto now = std::chrono::steady_clock::now();
-        int elapsed = (int)std::chrono::duration_cast<std::chrono::milliseconds>(now-start).count();
-        long long nps = elapsed>0 ? (long long)nodes * 1000LL / elapsed : 0LL;
-        std::string pv = buildPV(b);
-        std::cout << "info depth "<<depth
-                  << " score cp "<<bestScore
-                  << " time "<<elapsed
-                  << " nodes "<<nodes
-                  << " nps "<<nps
-                  << (pv.empty()? "" : std::string(" pv ")+pv)
-                  << std::endl;
-        // Allow completing this depth; stop before starting next one on soft time
-        if(timeUpLocal() || (timeUpSoft() && depth>=3)) break;
+        b.unmakeMove();
+        if(stop) break;
+        if(first || score > bestScore){ bestScore = score; bestMove = m; t.updatePV(0, m); t.bestMoveNodes = t.nodes.load(std::memory_order_relaxed) - moveStart; }
+        first = false;
+        if(score > alpha) alpha = score;
+        if(alpha >= beta) break;
+    }
+    t.rootNodes = t.nodes.load(std::memory_order_relaxed) - rootStart;
+    if(!stop && bestMove.ok() && skip.empty()){ // a MultiPV line's best is not the position's best
+        Bound bnd = (bestScore <= origAlpha) ? Bound::Upper : (bestScore >= beta ? Bound::Lower : Bound::Exact);
+        tt.store(key, depth, bestScore, bnd, bestMove);
     }
-    SearchResult res; res.score = bestScore; res.best = best; return res;
+    // a partial iteration still reports its best move so far; iterate() decides whether to keep it
+    if(bestMove.ok()) return best = bestMove, bestScore;
+    if(!firstMove.ok()){ best = Move{}; return bestScore; } // nothing to search: mate, stalemate or all skipped
+    // stopped inside the first move: keep the caller's move, or else the first legal one, so there is
+    // always a move to play; the score means nothing and is reported as 0
+    if(!best.ok()) best = firstMove;
+    t.pvLen[0] = 1; t.pv[0][0] = best;
+    return 0;
 }
 
-int Searcher::searchRec(Board& b, int depth, int alpha, int beta, int ply){
-    if(stop || timeUp()) { stop = true; return 0; }
-    ++nodes;
+void Searcher::clear(){
+    tt.clear(threads);
+    evalCache.clear();
+    for(auto& t : workers){ t->killers = {}; t->history = {}; }
+}
+
+int Searcher::searchRec(SearchThread& t, Board& b, int depth, int alpha, int beta, int ply){
+    t.pvLen[ply] = ply; // empty until a move raises alpha
+    if(stop || limitReached(t)) { stop = true; return 0; }
+    t.countNode();
+    if(ply > t.selDepth) t.selDepth = ply;
+    if(ply >= SearchThread::MAX_PLY - 1){ t.stats.inc(SearchStats::Nodes); return evalWithContempt(b); } // per-ply tables end here
     // draw checks
-    if(b.isDrawBy50() || b.repetitionCount() >= 3) return contempt; // drawish bias
-    if(depth==0) return quiesce(b, alpha, beta, ply);
+    if(b.isDrawBy50() || b.repetitionCount() >= 3){ t.stats.inc(SearchStats::Nodes); return contempt; } // drawish bias
+    if(depth==0) return quiesce(t, b, alpha, beta, ply); // counted there as a qsearch node
+    t.stats.inc(SearchStats::Nodes);
 
     // Detect if side to move is currently in check at this node
-    char sideNow = b.st.side; 
-    int ksqNow = (sideNow=='w')? b.st.wk : b.st.bk; 
-    bool inCheckNow = b.squareAttacked(ksqNow, (sideNow=='w')?'b':'w');
+    bool inCheckNow = b.inCheck();
 
     uint64_t key = b.positionKey();
     TTEntry e{};
-    if(tt.probe(key, e) && e.depth >= depth){
-        if(e.bound == (uint8_t)Bound::Exact) return e.score;
+    bool ttHit = tt.probe(key, e);
+    t.stats.inc(SearchStats::TTProbes);
+    if(ttHit) t.stats.inc(SearchStats::TTHits);
+    Move ttMove = ttHit ? e.best : Move{};
+    // no cutoffs at PV nodes: the line would end here and the triangular PV come out truncated
+    if(ttHit && e.depth >= depth && beta - alpha == 1){
+        if(e.bound == (uint8_t)Bound::Exact){ t.stats.inc(SearchStats::TTCutoffs); return e.score; }
         if(e.bound == (uint8_t)Bound::Lower && e.score > alpha) alpha = e.score;
         else if(e.bound == (uint8_t)Bound::Upper && e.score < beta) beta = e.score;
-        if(alpha >= beta) return e.score;
+        if(alpha >= beta){ t.stats.inc(SearchStats::TTCutoffs); return e.score; }
     }
 
     // Null-move pruning: skip when in check
     if(depth >= 3 && !inCheckNow){
         if(b.makeNullMove()){
+            t.stats.inc(SearchStats::NullTries);
             int R = 2 + (depth > 6); // simple reduction
-            int score = -searchRec(b, depth - 1 - R, -beta, -beta + 1, ply+1);
+            int score = -searchRec(t, b, depth - 1 - R, -beta, -beta + 1, ply+1);
             b.unmakeNullMove();
-            if(score >= beta) return beta;
+            if(score >= beta){ t.stats.inc(SearchStats::NullCutoffs); return beta; }
         }
     }
 
-    auto moves = b.generateLegalMoves();
-    if(moves.empty()){
-        char side = b.st.side; int ksq = (side=='w')? b.st.wk : b.st.bk; bool inCheck = b.squareAttacked(ksq, (side=='w')?'b':'w');
-        if(inCheck) return -100000 + ply; // mate distance
-        return 0; // stalemate
-    }
-
-    // Move ordering: TT move first, then captures by MVV-LVA, then killers, then history
-    Move ttMove = (tt.probe(key, e) ? e.best : Move{});
-    std::sort(moves.begin(), moves.end(), [&](const Move& a, const Move& bmv){
-        auto scoreMove = [&](const Move& m){
-            int score = 0;
-            if(m.from==ttMove.from && m.to==ttMove.to && (!((m.flags & PROMOTION) && ttMove.promo && m.promo!=ttMove.promo))) score += 1'000'000;
-            if(m.flags & (CAPTURE|EN_PASSANT|PROMOTION)) score += 100'000 + mvv_lva(b, m);
-            // killers
-            for(int i=0;i<2;i++){ if(killers[ply][i].from==m.from && killers[ply][i].to==m.to) { score += 50'000; break; } }
-            // history (very simple: index by from square per side)
-            int sideIdx = (b.st.side=='w')?0:1;
-            score += history[sideIdx][m.from & 63];
-            return score;
-        };
-        return scoreMove(a) > scoreMove(bmv);
-    });
+    // Move ordering: TT move first, then good captures by MVV-LVA, killers, quiets by history, bad captures
+    int sideIdx = b.st.side;
+    MovePicker mp(b, ttMove, t.killers[ply].data(), &t.history[sideIdx]);
 
     Move best = {};
     int bestScore = std::numeric_limits<int>::min();
     int origAlpha = alpha;
     int moveIndex = 0;
+    int legalMoves = 0;
+    int searched = 0; // moves actually searched, for the fail-high-first statistic
     bool first = true;
-    for(const auto& m: moves){
-        if(!b.makeMove(m)) continue;
+    Move m;
+    while(mp.next(m)){
+        legalMoves++;
+        bool isCapture = b.isTactical(m);
+        // Prune captures that lose material in the exchange, judged before the move is played; the
+        // picker has already shown its good captures to be at least even
+        if(isCapture && mp.stage() != MovePicker::GOOD_CAPTURES && !b.see_ge(m, -20)){ t.stats.inc(SearchStats::SeePrunes); moveIndex++; continue; }
         int nextDepth = depth - 1 + (inCheckNow ? 1 : 0); // check extension
+        // start fetching the child's hash bucket (or eval slot at the horizon) while the move is made
+        uint64_t childKey = b.keyAfter(m);
+        if(nextDepth > 0) tt.prefetch(childKey); else evalCache.prefetch(childKey);
+        b.makeMove(m);
         int score;
-        bool isCapture = (m.flags & (CAPTURE|EN_PASSANT|PROMOTION));
         // Futility pruning: near leaf on quiet moves, if stand pat + margin <= alpha
         if(!inCheckNow && nextDepth == 0 && !isCapture){
             int stand = evalWithContempt(b);
             int margin = 150; // conservative
-            if(stand + margin <= alpha){ b.unmakeMove(); moveIndex++; continue; }
+            if(stand + margin <= alpha){ t.stats.inc(SearchStats::FutilityPrunes); b.unmakeMove(); moveIndex++; continue; }
         }
         // Light Late Move Pruning: skip very late quiet moves at low depth
-        if(!inCheckNow && !isCapture && depth <= 3 && moveIndex > 12){ b.unmakeMove(); moveIndex++; continue; }
-        // Prune obviously bad captures (light SEE)
-        if(isCapture){ int stand = evalWithContempt(b); if(badCaptureHeuristic(b, m, stand)){ b.unmakeMove(); moveIndex++; continue; } }
+        if(!inCheckNow && !isCapture && depth <= 3 && moveIndex > 12){ t.stats.inc(SearchStats::LmpPrunes); b.unmakeMove(); moveIndex++; continue; }
         // Late Move Reductions: reduce depth for quiet, late moves
         if(!inCheckNow && nextDepth >= 2 && !isCapture && moveIndex > 3){
             int R = 1 + (moveIndex > 8);
             // Principal Variation Search (PVS)
             if(first){
-                score = -searchRec(b, nextDepth, -beta, -alpha, ply+1);
+                score = -searchRec(t, b, nextDepth, -beta, -alpha, ply+1);
                 first = false;
             } else {
-                score = -searchRec(b, nextDepth - R, -alpha-1, -alpha, ply+1);
+                t.stats.inc(SearchStats::LmrSearches);
+                score = -searchRec(t, b, nextDepth - R, -alpha-1, -alpha, ply+1);
                 if(score > alpha){
-                    score = -searchRec(b, nextDepth, -beta, -alpha, ply+1);
+                    t.stats.inc(SearchStats::LmrResearches);
+                    score = -searchRec(t, b, nextDepth, -beta, -alpha, ply+1);
                 }
             }
         } else {
             // Principal Variation Search: first move full window, rest zero-window
             if(first){
-                score = -searchRec(b, nextDepth, -beta, -alpha, ply+1);
+                score = -searchRec(t, b, nextDepth, -beta, -alpha, ply+1);
                 first = false;
             } else {
-                score = -searchRec(b, nextDepth, -alpha-1, -alpha, ply+1);
+                score = -searchRec(t, b, nextDepth, -alpha-1, -alpha, ply+1);
                 if(score > alpha){
-                    score = -searchRec(b, nextDepth, -beta, -alpha, ply+1);
+                    score = -searchRec(t, b, nextDepth, -beta, -alpha, ply+1);
                 }
             }
         }
         b.unmakeMove();
+        searched++;
         if(score >= beta){
+            t.stats.inc(SearchStats::FailHighs);
+            if(searched == 1) t.stats.inc(SearchStats::FailHighsFirst);
             // store killer/history
-            if(!(m.flags & (CAPTURE|EN_PASSANT|PROMOTION))){
-                std::lock_guard<std::mutex> lk(khMutex);
-                killers[ply][1] = killers[ply][0];
-                killers[ply][0] = m;
-                int sideIdx = (b.st.side=='w')?1:0; // just switched back
-                history[sideIdx][m.from & 63] += depth * depth;
+            if(!isCapture){
+                t.killers[ply][1] = t.killers[ply][0];
+                t.killers[ply][0] = m;
+                t.history[sideIdx][m.from()] += depth * depth;
             }
-            if(tt.probe(key, e)){} // no-op
             tt.store(key, depth, beta, Bound::Lower, m);
             return beta;
         }
         if(score > bestScore){ bestScore = score; best = m; }
-        if(score > alpha){ alpha = score; best = m; }
+        if(score > alpha){ alpha = score; best = m; t.updatePV(ply, m); }
         moveIndex++;
     }
+    if(legalMoves == 0){
+        if(inCheckNow) return -100000 + ply; // mate distance
+        return 0; // stalemate
+    }
     Bound bnd = (alpha <= origAlpha) ? Bound::Upper : (alpha >= beta ? Bound::Lower : Bound::Exact);
     tt.store(key, depth, alpha, bnd, best);
     return alpha;
 }
 
-int Searcher::quiesce(Board& b, int alpha, int beta, int ply){
-    if(stop || timeUp()) { stop = true; return alpha; }
-    ++nodes;
+int Searcher::quiesce(SearchThread& t, Board& b, int alpha, int beta, int ply){
+    if(stop || limitReached(t)) { stop = true; return alpha; }
+    t.countNode();
+    t.stats.inc(SearchStats::QNodes);
+    if(ply > t.selDepth) t.selDepth = ply;
     // If in check, search all legal evasions (no stand-pat)
-    char side = b.st.side; int ksq = (side=='w')? b.st.wk : b.st.bk; bool inCheck = b.squareAttacked(ksq, (side=='w')?'b':'w');
-    if(inCheck){
-        auto evasions = b.generateLegalMoves();
-        if(evasions.empty()) return -100000 + ply; // checkmated
-        for(const auto& m: evasions){
-            if(!b.makeMove(m)) continue;
-            int score = -quiesce(b, -beta, -alpha, ply+1);
+    if(b.inCheck()){
+        MovePicker evasions(b, Move{}, nullptr, nullptr);
+        Move m; bool any = false;
+        while(evasions.next(m)){
+            any = true;
+            b.makeMove(m);
+            int score = -quiesce(t, b, -beta, -alpha, ply+1);
             b.unmakeMove();
             if(score >= beta) return beta;
             if(score > alpha) alpha = score;
         }
+        if(!any) return -100000 + ply; // checkmated
         return alpha;
     }
 
@@ -376,20 +435,19 @@ int Searcher::quiesce(Board& b, int alpha, int beta, int ply){
     if(stand >= beta) return beta;
     if(alpha < stand) alpha = stand;
 
-    auto caps = b.generateCaptures();
-    std::sort(caps.begin(), caps.end(), [&](const Move& m1, const Move& m2){ return mvv_lva(b,m1) > mvv_lva(b,m2); });
-
-    for(const auto& m: caps){
+    MovePicker caps(b);
+    Move m;
+    while(caps.next(m)){
         // Delta pruning: skip captures that cannot raise alpha enough
-        if(m.flags & CAPTURE){
-            char captured = b.st.board[m.to];
-            int gain = std::abs(pieceVal(captured));
-            if(stand + gain + 50 <= alpha) continue;
+        if(b.isCapture(m)){
+            int gain = pieceVal(b.pieceOn(m.to()));
+            if(stand + gain + 50 <= alpha){ t.stats.inc(SearchStats::QDeltaPrunes); continue; }
         }
-        // Light SEE prune
-        if(badCaptureHeuristic(b, m, stand)) continue;
-        if(!b.makeMove(m)) continue;
-        int score = -quiesce(b, -beta, -alpha, ply+1);
+        // SEE prune: skip captures that lose the exchange
+        if(!b.see_ge(m, -20)){ t.stats.inc(SearchStats::QSeePrunes); continue; }
+        evalCache.prefetch(b.keyAfter(m));
+        b.makeMove(m);
+        int score = -quiesce(t, b, -beta, -alpha, ply+1);
         b.unmakeMove();
         if(score >= beta) return beta;
         if(score > alpha) alpha = score;
@@ -398,10 +456,13 @@ int Searcher::quiesce(Board& b, int alpha, int beta, int ply){
 }
 
 int Searcher::evalWithContempt(const Board& b) const{
-    int e = Eval::evaluate(b);
+    // the classical and NNUE evaluations of a position differ, so they are cached under different keys
+    uint64_t key = b.positionKey() ^ (NNUE::isEnabled() && NNUE::isReady() ? 0x9E3779B97F4A7C15ULL : 0);
+    int e;
+    if(!evalCache.probe(key, e)){ e = Eval::evaluate(b); evalCache.store(key, e); }
     // If near draw by 50-move or repetition likely, bias by contempt
     if(b.isDrawBy50() || b.repetitionCount() >= 2){
-        e += (b.st.side=='w' ? contempt : -contempt);
+        e += (b.st.side==WHITE ? contempt : -contempt);
     }
     return e;
 }
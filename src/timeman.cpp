@@ -0,0 +1,31 @@
+#include "timeman.h"
+#include <algorithm>
+
+namespace eng {
+
+TimeLimits TimeManager::allocate(int time, int inc, int movestogo, int moveOverhead){
+    // plan over at most 50 moves; sudden death assumes 40 more
+    int mtg = movestogo > 0 ? std::min(movestogo, 50) : 40;
+    // every future move pays the overhead, and we keep a couple in reserve
+    long long left = (long long)time + (long long)inc * (mtg - 1) - (long long)moveOverhead * (mtg + 2);
+    left = std::max(1LL, left);
+    TimeLimits tl;
+    tl.maximum = (int)std::max(1LL, std::min<long long>(time * 4LL / 5 - moveOverhead, left * 5 / mtg));
+    tl.optimum = (int)std::max(1LL, std::min<long long>(left / mtg, tl.maximum));
+    return tl;
+}
+
+TimeLimits TimeManager::fixed(int movetime, int moveOverhead){
+    TimeLimits tl;
+    tl.optimum = tl.maximum = std::max(1, movetime - moveOverhead);
+    return tl;
+}
+
+double TimeManager::scale(double bestMoveChanges, int scoreDrop, double bestMoveNodeShare){
+    double instability = 1.0 + std::min(2.0, bestMoveChanges);                    // up to 3x while the move flips
+    double falling = std::clamp(1.0 + scoreDrop / 100.0 * 0.25, 0.8, 1.5);         // +25% per pawn lost
+    double effort = std::clamp(1.5 - bestMoveNodeShare, 0.6, 1.0);                 // one move hogging the tree: stop early
+    return instability * falling * effort;
+}
+
+} // namespace eng
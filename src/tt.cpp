@@ -0,0 +1,172 @@
+#include "tt.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace eng {
+
+static constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+void TT::release(){
+    if(!table) return;
+#if defined(_WIN32)
+    _aligned_free(table);
+#else
+    std::free(table);
+#endif
+    table = nullptr; clusterCount = 0; allocBytes = 0;
+}
+
+bool TT::resizeMB(size_t mb, int threads){
+    size_t n = mb * 1024ull * 1024ull / sizeof(Cluster);
+    if(n < 256) n = 256;
+    // round the allocation up to whole huge pages so the kernel can back all of it with them
+    size_t bytes = (n * sizeof(Cluster) + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+#if defined(_WIN32)
+    void* mem = _aligned_malloc(bytes, HUGE_PAGE);
+#else
+    void* mem = std::aligned_alloc(HUGE_PAGE, bytes);
+#endif
+    if(!mem) return false; // the old table stays in use
+    release();
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    madvise(mem, bytes, MADV_HUGEPAGE); // advisory: without transparent huge pages this is a no-op
+#endif
+    table = new (mem) Cluster[n]; // trivial construction, nothing is touched yet
+    clusterCount = n; allocBytes = bytes;
+    clear(threads); // first touch happens here, spread over the search threads
+    return true;
+}
+
+void TT::clear(int threads){
+    generation = 1;
+    if(!table) return;
+    if(threads < 1) threads = 1;
+    size_t chunk = (clusterCount + threads - 1) / threads;
+    auto zero = [&](int t){
+        size_t begin = t * chunk, end = std::min(clusterCount, begin + chunk);
+        if(begin < end) std::memset(static_cast<void*>(table + begin), 0, (end - begin) * sizeof(Cluster));
+    };
+    if(threads == 1){ zero(0); return; }
+    std::vector<std::thread> pool;
+    for(int t=0; t<threads; ++t) pool.emplace_back(zero, t);
+    for(auto& th : pool) th.join();
+}
+
+void TT::store(uint64_t key, int depth, int score, Bound bnd, const Move& best){
+    if(!table) return;
+    Cluster& c = cluster(key);
+    Slot* victim = nullptr;
+    int victimValue = 0;
+    for(Slot& s : c.slots){
+        uint64_t d = s.data.load(std::memory_order_relaxed);
+        if(!d){ victim = &s; break; } // empty
+        if((s.keyXorData.load(std::memory_order_relaxed) ^ d) == key){
+            // same position: keep a deeper entry from this search unless the new one is exact
+            int oldDepth = int8_t(d >> 16);
+            if(bnd != Bound::Exact && uint8_t(d >> 48) == generation && depth + 2 < oldDepth) return;
+            Move keep = best.ok() ? best : Move{uint16_t(d >> 32)};
+            uint64_t nd = pack(int16_t(score), int8_t(depth), bnd, keep, generation);
+            s.keyXorData.store(key ^ nd, std::memory_order_relaxed);
+            s.data.store(nd, std::memory_order_relaxed);
+            return;
+        }
+        // depth minus age: older searches' entries lose 8 plies of worth per generation
+        int age = uint8_t(generation - uint8_t(d >> 48));
+        int value = int8_t(d >> 16) - 8 * age;
+        if(!victim || value < victimValue){ victim = &s; victimValue = value; }
+    }
+    uint64_t nd = pack(int16_t(score), int8_t(depth), bnd, best, generation);
+    victim->keyXorData.store(key ^ nd, std::memory_order_relaxed);
+    victim->data.store(nd, std::memory_order_relaxed);
+}
+
+// on-disk header; bump FILE_VERSION whenever Slot packing or clustering changes
+struct TTFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t clusterBytes;
+    uint32_t slotsPerCluster;
+    uint32_t generation;
+    uint64_t clusterCount;
+};
+static const char TT_MAGIC[8] = {'N','O','X','H','A','S','H','\0'};
+static constexpr uint32_t FILE_VERSION = 1;
+
+bool TT::save(const std::string& path, std::string& err) const{
+    if(!table){ err = "no table allocated"; return false; }
+    TTFileHeader h{};
+    std::memcpy(h.magic, TT_MAGIC, sizeof(h.magic));
+    h.version = FILE_VERSION; h.clusterBytes = sizeof(Cluster); h.slotsPerCluster = CLUSTER_SIZE;
+    h.generation = generation; h.clusterCount = clusterCount;
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if(!f){ err = "cannot open " + path; return false; }
+    f.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    f.write(reinterpret_cast<const char*>(table), std::streamsize(clusterCount * sizeof(Cluster)));
+    if(!f){ err = "write failed"; return false; }
+    return true;
+}
+
+bool TT::load(const std::string& path, std::string& err){
+    if(!table){ err = "no table allocated"; return false; }
+    size_t body = clusterCount * sizeof(Cluster);
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){ err = "cannot open " + path; return false; }
+    struct stat sb;
+    if(fstat(fd, &sb) != 0 || size_t(sb.st_size) < sizeof(TTFileHeader)){ ::close(fd); err = "not a hash file"; return false; }
+    void* map = mmap(nullptr, size_t(sb.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(map == MAP_FAILED){ err = "mmap failed"; return false; }
+    const char* src = static_cast<const char*>(map);
+    size_t fileBytes = size_t(sb.st_size);
+#else
+    std::ifstream f(path, std::ios::binary);
+    if(!f){ err = "cannot open " + path; return false; }
+    std::vector<char> buf((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    const char* src = buf.data();
+    size_t fileBytes = buf.size();
+    if(fileBytes < sizeof(TTFileHeader)){ err = "not a hash file"; return false; }
+#endif
+    TTFileHeader h;
+    std::memcpy(&h, src, sizeof(h));
+    bool ok = false;
+    if(std::memcmp(h.magic, TT_MAGIC, sizeof(h.magic)) != 0) err = "not a hash file";
+    else if(h.version != FILE_VERSION || h.clusterBytes != sizeof(Cluster) || h.slotsPerCluster != CLUSTER_SIZE) err = "incompatible entry format";
+    else if(h.clusterCount != clusterCount) err = "table size differs, set Hash to the size it was saved with";
+    else if(fileBytes != sizeof(h) + body) err = "truncated file";
+    else {
+        std::memcpy(static_cast<void*>(table), src + sizeof(h), body);
+        generation = uint8_t(h.generation);
+        ok = true;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    munmap(map, fileBytes);
+#endif
+    return ok;
+}
+
+int TT::hashfull() const{
+    if(!table) return 0;
+    int used = 0, samples = 0;
+    for(size_t i=0; i<clusterCount && samples < 1000; ++i){
+        for(const Slot& s : table[i].slots){
+            uint64_t d = s.data.load(std::memory_order_relaxed);
+            if(d && uint8_t(d >> 48) == generation) used++;
+            samples++;
+        }
+    }
+    return used * 1000 / samples;
+}
+
+} // namespace eng
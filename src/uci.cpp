@@ -1,10 +1,13 @@
 #include "uci.h"
 #include "nnue.h"
+#include "bench.h"
 #include "eval.h"
+#include "perft.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
 #include <cctype>
+#include <chrono>
 
 namespace eng {
 
@@ -12,13 +15,6 @@ static std::string trim(const std::string& s){
     size_t a = s.find_first_not_of(" \t\r\n"); if(a==std::string::npos) return ""; size_t b = s.find_last_not_of(" \t\r\n"); return s.substr(a, b-a+1);
 }
 
-static uint64_t perftRec(Board& b, int depth){
-    if(depth==0) return 1ULL;
-    uint64_t nodes=0; auto moves=b.generateLegalMoves();
-    for(const auto& m: moves){ if(!b.makeMove(m)) continue; nodes += perftRec(b, depth-1); b.unmakeMove(); }
-    return nodes;
-}
-
 bool UCI::tryBookMove(Move& out){
     // Tiny built-in book: startpos first move only
     static int rot = 0; // simple round-robin
@@ -28,7 +24,7 @@ bool UCI::tryBookMove(Move& out){
         std::vector<std::string> cands = {"e2e4","d2d4","c2c4","g1f3"};
         std::string s = cands[rot++ % cands.size()];
         out = parseUciMove(s);
-        if(out.from||out.to) return true;
+        if(out.ok()) return true;
     }
     return false;
 }
@@ -43,14 +39,29 @@ void UCI::loop(){
         line = trim(line);
         if(line.empty()) continue;
         if(debug) std::cerr << "[debug] recv: " << line << std::endl;
+        // the reader never blocks on a search it has no way to end: unknown input is dropped, and a
+        // command that touches the board, options or tables stops a running search first
+        static const char* const COMMANDS[] = {"uci","isready","setoption","ucinewgame","position","go","stop","ponderhit","quit","debug","perft","hash","stats","evalfen","bench"};
+        std::string cmd = line.substr(0, line.find(' '));
+        if(std::find(std::begin(COMMANDS), std::end(COMMANDS), cmd) == std::end(COMMANDS)){
+            if(debug) std::cerr << "[debug] unknown command: " << line << std::endl;
+            continue;
+        }
+        if(cmd != "isready" && cmd != "stop" && cmd != "quit" && cmd != "ponderhit" && cmd != "debug"){
+            if(searching){ std::cout << "info string " << cmd << " during a search, stopping it" << std::endl; stopSearch(); }
+            else waitForSearch(); // the last search has already answered; just reap its thread
+        }
         if(line == "uci"){
             std::cout << "id name nox_engine" << std::endl;
             std::cout << "id author Ahmed Tabish" << std::endl;
             std::cout << "option name Skill Level type spin default 10 min 1 max 20" << std::endl;
             std::cout << "option name Debug type check default false" << std::endl;
-            std::cout << "option name Hash type spin default 16 min 1 max 4096" << std::endl;
+            std::cout << "option name Hash type spin default 16 min 1 max 65536" << std::endl;
             std::cout << "option name Contempt type spin default 0 min -200 max 200" << std::endl;
             std::cout << "option name Threads type spin default 1 min 1 max 64" << std::endl;
+            std::cout << "option name Ponder type check default false" << std::endl;
+            std::cout << "option name MultiPV type spin default 1 min 1 max 64" << std::endl;
+            std::cout << "option name Move Overhead type spin default 10 min 0 max 5000" << std::endl;
             std::cout << "option name UseBook type check default true" << std::endl;
             std::cout << "option name Use NNUE type check default false" << std::endl;
             std::cout << "option name EvalFile type string default" << std::endl;
@@ -62,23 +73,39 @@ void UCI::loop(){
         } else if(line.rfind("setoption",0)==0){
             cmdSetOption(line);
         } else if(line.rfind("perft",0)==0){
-            std::istringstream ss(line); std::string w; ss>>w; int d=1; ss>>d; if(d<0) d=0; Board tmp=board; uint64_t n=perftRec(tmp,d); std::cout<<n<<std::endl; std::cout.flush();
+            cmdPerft(line);
+        } else if(line.rfind("hash save ",0)==0 || line.rfind("hash load ",0)==0){
+            // hash save|load <file>: the table image must match the current Hash size to load
+            bool save = line[5]=='s'; std::string path = trim(line.substr(10)), err;
+            bool ok = save? searcher.tt.save(path, err) : searcher.tt.load(path, err);
+            std::cout << "info string hash " << (save? "save" : "load") << (ok? " ok " : " failed: ") << (ok? path : err) << std::endl;
+        } else if(line == "stats"){
+            searcher.printStats(std::cout); // counters of the last search; needs a NOX_STATS build
         } else if(line.rfind("evalfen ",0)==0){
             std::string fen = line.substr(8);
-            Board tmp; tmp.setFEN(fen);
+            Board tmp; std::string err;
+            if(!tmp.setFEN(fen, err)){ std::cout << "info string invalid fen (" << err << ")" << std::endl; continue; }
             int score = 0;
             if (NNUE::isEnabled() && NNUE::isReady()) score = NNUE::evaluate(tmp);
             else score = Eval::evaluate(tmp);
             std::cout << score << std::endl; std::cout.flush();
+        } else if(line.rfind("bench",0)==0){
+            // bench [depth] [threads] [hashMB]
+            std::istringstream ss(line); std::string w; ss>>w; int d=8, t=1; size_t mb=16; ss>>d>>t>>mb;
+            Bench::run(std::max(1, d), std::max(1, t), std::max<size_t>(1, mb));
         } else if(line == "ucinewgame"){
             board.setStartPos();
+            searcher.clear();
         } else if(line.rfind("position",0)==0){
             cmdPosition(line);
         } else if(line.rfind("go",0)==0){
             cmdGo(line);
+        } else if(line == "ponderhit"){
+            searcher.ponderhit(); // the opponent played the expected move: keep searching, now on our clock
         } else if(line == "stop"){
-            searcher.stop = true;
+            stopSearch();
         } else if(line == "quit"){
+            stopSearch();
             break;
         } else if(line.rfind("debug",0)==0){
             std::istringstream ss(line); std::string w, v; ss>>w>>v; if(!v.empty()) debug = (v=="on");
@@ -86,6 +113,21 @@ void UCI::loop(){
     }
 }
 
+void UCI::cmdPerft(const std::string& line){
+    // perft [divide] <depth> [hashMB]; root moves are split across Threads, hashMB 0 disables the table
+    std::istringstream ss(line); std::string w; ss>>w;
+    bool div = false; if(ss>>w && w=="divide"){ div = true; ss>>w; }
+    int d=1; size_t hashMB=64;
+    try{ d = std::max(0, std::stoi(w)); } catch(...){}
+    ss>>hashMB;
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t n = div? Perft::divide(board, d, threads, hashMB) : Perft::count(board, d, threads, hashMB);
+    long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "info string perft time " << ms << " nps " << (ms? n * 1000 / ms : 0) << std::endl;
+    if(!div) std::cout << n << std::endl;
+    std::cout.flush();
+}
+
 void UCI::cmdSetOption(const std::string& line){
     // setoption name <name> value <val>
     std::istringstream ss(line);
@@ -103,11 +145,19 @@ void UCI::cmdSetOption(const std::string& line){
     } else if(lname == "debug"){
         std::string lv = value; std::transform(lv.begin(), lv.end(), lv.begin(), ::tolower); debug = (lv=="true"||lv=="on"||lv=="1");
     } else if(lname == "hash"){
-        try{ int mb = std::stoi(value); if(mb<1) mb=1; if(mb>4096) mb=4096; searcher.tt.resizeMB((size_t)mb); } catch(...){}
+        try{
+            int mb = std::stoi(value); if(mb<1) mb=1; if(mb>65536) mb=65536;
+            if(!searcher.tt.resizeMB((size_t)mb, threads))
+                std::cout << "info string cannot allocate " << mb << " MB for Hash, keeping " << searcher.tt.sizeMB() << " MB" << std::endl;
+        } catch(...){}
     } else if(lname == "contempt"){
         try{ int c = std::stoi(value); if(c<-200) c=-200; if(c>200) c=200; searcher.contempt = c; } catch(...){}
+    } else if(lname == "multipv"){
+        try{ searcher.multiPV = std::clamp(std::stoi(value), 1, 64); } catch(...){}
+    } else if(lname == "move overhead"){
+        try{ moveOverhead = std::clamp(std::stoi(value), 0, 5000); } catch(...){}
     } else if(lname == "threads"){
-        try{ int t = std::stoi(value); if(t<1) t=1; if(t>64) t=64; threads=t; searcher.threads=t; } catch(...){}
+        try{ int t = std::stoi(value); if(t<1) t=1; if(t>64) t=64; threads=t; searcher.setThreads(t); } catch(...){}
     } else if(lname == "usebook"){
         std::string lv = value; std::transform(lv.begin(), lv.end(), lv.begin(), ::tolower); useBook = (lv=="true"||lv=="on"||lv=="1");
     } else if(lname == "use nnue"){
@@ -129,11 +179,13 @@ void UCI::cmdPosition(const std::string& line){
         board.setStartPos();
         ss >> word; // maybe moves
     } else if(word == "fen"){
-        std::string f1,f2,f3,f4,f5,f6; ss >> f1 >> f2 >> f3 >> f4 >> f5 >> f6; std::string fen = f1+" "+f2+" "+f3+" "+f4+" "+f5+" "+f6; board.setFEN(fen); ss >> word; // maybe moves
+        std::string f1,f2,f3,f4,f5,f6; ss >> f1 >> f2 >> f3 >> f4 >> f5 >> f6; std::string fen = f1+" "+f2+" "+f3+" "+f4+" "+f5+" "+f6, err;
+        if(!board.setFEN(fen, err)){ std::cout << "info string invalid fen (" << err << "), position unchanged" << std::endl; return; }
+        ss >> word; // maybe moves
     }
     if(word == "moves"){
         std::string mv;
-        while(ss >> mv){ Move m = parseUciMove(mv); if(m.from||m.to) board.makeMove(m); }
+        while(ss >> mv){ Move m = parseUciMove(mv); if(m.ok()) board.makeMove(m); }
     }
     if(debug) std::cerr << "[debug] position -> "<< board.getFEN() << std::endl;
 }
@@ -142,45 +194,55 @@ Move UCI::parseUciMove(const std::string& s){
     if(s.size() < 4) return Move{};
     Square from = coordToSq(s.substr(0,2));
     Square to   = coordToSq(s.substr(2,2));
-    char promo = 0; if(s.size()>=5){ char c = std::tolower(s[4]); if(c=='q'||c=='r'||c=='b'||c=='n'){ promo = (board.st.side=='w')? std::toupper(c) : c; } }
-    auto moves = board.generateLegalMoves();
-    for(const auto& m: moves){ if(m.from==from && m.to==to){ if((m.flags & PROMOTION)){ if(promo && m.promo==promo) return m; else continue; } return m; } }
+    char promo = s.size()>=5? std::tolower(s[4]) : 0;
+    MoveList moves; board.generateLegalMoves(moves);
+    for(const auto& m: moves){ if(m.from()==from && m.to()==to){ if(m.type() == PROMOTION){ if(promo == "nbrq"[m.promo() - KNIGHT]) return m; else continue; } return m; } }
     return Move{};
 }
 
 std::string UCI::moveToUci(const Move& m) const{
-    std::string s = sqToCoord(m.from) + sqToCoord(m.to);
-    if((m.flags & PROMOTION) && m.promo) s += (char)std::tolower(m.promo);
-    return s;
+    return eng::moveToUci(m);
 }
 
 void UCI::cmdGo(const std::string& line){
-    // go wtime 300000 btime 300000 winc 2000 binc 2000 movestogo 40 depth 10 movetime 1000
+    // go wtime 300000 btime 300000 winc 2000 binc 2000 movestogo 40 depth 10 movetime 1000 nodes 100000 [infinite|ponder]
     std::istringstream ss(line);
     std::string word; ss >> word; // go
-    int wtime=-1,btime=-1,winc=0,binc=0,movestogo=30,depth=0,movetime=-1;
+    int wtime=-1,btime=-1,winc=0,binc=0,movestogo=0,depth=0,movetime=-1; uint64_t nodes=0; bool infinite=false, ponder=false;
     while(ss>>word){
-        if(word=="wtime") ss>>wtime; else if(word=="btime") ss>>btime; else if(word=="winc") ss>>winc; else if(word=="binc") ss>>binc; else if(word=="movestogo") ss>>movestogo; else if(word=="depth") ss>>depth; else if(word=="movetime") ss>>movetime; }
-    int useDepth = depth? depth : searcher.maxDepth;
-    int timeMs = 1000;
-    if(movetime>0) timeMs = movetime; else {
-        if(board.st.side=='w' && wtime>=0) timeMs = std::max(10, wtime/ (movestogo>0? movestogo:30) + winc/2);
-        else if(board.st.side=='b' && btime>=0) timeMs = std::max(10, btime/ (movestogo>0? movestogo:30) + binc/2);
-        else timeMs = 1000;
-    }
-    if(debug) std::cerr << "[debug] go timeMs="<<timeMs<<" depth="<<useDepth<< std::endl;
+        if(word=="wtime") ss>>wtime; else if(word=="btime") ss>>btime; else if(word=="winc") ss>>winc; else if(word=="binc") ss>>binc; else if(word=="movestogo") ss>>movestogo; else if(word=="depth") ss>>depth; else if(word=="movetime") ss>>movetime; else if(word=="infinite") infinite=true; else if(word=="ponder") ponder=true; else if(word=="nodes") ss>>nodes; }
+    // go nodes on its own is limited by the node count alone, like go infinite but ending by itself
+    bool nodesOnly = nodes && !depth && movetime<0 && (board.st.side==WHITE? wtime : btime)<0;
+    bool unlimited = infinite || nodesOnly;
+    int useDepth = depth? depth : unlimited? SearchThread::MAX_PLY / 2 : searcher.maxDepth;
+    int time = board.st.side==WHITE? wtime : btime, inc = board.st.side==WHITE? winc : binc;
+    TimeLimits tl = TimeManager::fixed(1000, 0);
+    if(unlimited) tl = TimeManager::fixed(1000000000, 0); // only stop or the node limit ends it
+    else if(movetime>0) tl = TimeManager::fixed(movetime, moveOverhead);
+    else if(time>=0) tl = TimeManager::allocate(time, inc, movestogo, moveOverhead);
+    if(debug) std::cerr << "[debug] go optimum="<<tl.optimum<<" maximum="<<tl.maximum<<" depth="<<useDepth<< std::endl;
     // Try to load NNUE at go time if enabled and not yet ready
     if(useNNUE && !evalFile.empty() && !NNUE::isReady()){
         NNUE::load(evalFile);
     }
-    int prevDepth = searcher.maxDepth; searcher.maxDepth = useDepth; searcher.threads = threads;
     // Try book move if enabled
-    if(useBook){ Move bm; if(tryBookMove(bm)){ std::cout << "bestmove " << moveToUci(bm) << std::endl; std::cout.flush(); return; } }
-    SearchResult res = searcher.search(board, timeMs);
-    searcher.maxDepth = prevDepth;
-    if(res.best.from==0 && res.best.to==0){ std::cout << "bestmove 0000" << std::endl; }
-    else { std::cout << "bestmove " << moveToUci(res.best) << std::endl; }
-    std::cout.flush();
+    if(useBook && !infinite && !ponder){ Move bm; if(tryBookMove(bm)){ std::cout << "bestmove " << moveToUci(bm) << std::endl; std::cout.flush(); return; } }
+    // reset here, not on the search thread, so a stop read before that thread starts is not lost
+    stopRequested = false; searcher.stop = false; searching = true;
+    searcher.nodeLimit = nodes;
+    searcher.pondering = ponder; // tl is the budget for after ponderhit
+    searchThread = std::thread([this, useDepth, tl, infinite]{
+        int prevDepth = searcher.maxDepth; searcher.maxDepth = useDepth;
+        SearchResult res = searcher.search(board, tl);
+        searcher.maxDepth = prevDepth;
+        // go infinite and go ponder may finish their depths early, but bestmove must wait for stop/ponderhit
+        while((infinite || searcher.pondering) && !stopRequested) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        searcher.pondering = false;
+        std::string out = "bestmove " + (res.best.ok()? moveToUci(res.best) : std::string("0000"));
+        if(res.ponder.ok()) out += " ponder " + moveToUci(res.ponder);
+        std::cout << out << std::endl;
+        searching = false;
+    });
 }
 
 } // namespace eng